@@ -0,0 +1,230 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "allocstats.h"
+
+#ifdef IW_DEBUG
+
+#include "s3eDebug.h"
+#include "trace.h"
+
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+// Each block is preceded by a header recording its size, so that delete can account for it.
+// The header is 16 bytes to keep the block aligned for any type
+#define ALLOC_HEADER_SIZE 16
+
+struct AllocCallSite
+{
+    void* address;
+    AllocCounts counts;
+};
+
+// Allocations this frame, by phase
+static AllocCounts s_Frame[NUM_PROFILE_PHASES + 1];
+static AllocCounts s_FrameTotal;
+
+// Previous frame
+static AllocCounts s_LastFrame[NUM_PROFILE_PHASES + 1];
+static AllocCounts s_LastFrameTotal;
+static uint32 s_LastFramePeak = 0;
+
+static AllocCounts s_Total;
+static AllocCounts s_GameStart;
+static uint32 s_LiveBytes = 0;
+static uint32 s_FramePeak = 0;
+static uint32 s_GamePeak = 0;
+
+// Open-addressed table of call sites. Allocations from sites which don't fit are counted in s_OtherSites
+static AllocCallSite s_CallSites[MAX_ALLOC_CALL_SITES];
+static AllocCounts s_OtherSites;
+
+static void RecordCallSite(void* address, uint32 size)
+{
+    uint32 hash = (uint32)((uintptr_t)address >> 2) * 2654435761u;
+    for (int i=0; i<MAX_ALLOC_CALL_SITES; i++)
+    {
+        AllocCallSite& site = s_CallSites[(hash + i) % MAX_ALLOC_CALL_SITES];
+        if (site.address == address || !site.address)
+        {
+            site.address = address;
+            site.counts.count++;
+            site.counts.bytes += size;
+            return;
+        }
+    }
+
+    s_OtherSites.count++;
+    s_OtherSites.bytes += size;
+}
+
+// Note: the resource loader's worker thread doesn't use new, so this isn't made thread-safe
+static void* Allocate(size_t size, void* caller)
+{
+    char* block = (char*)malloc(size + ALLOC_HEADER_SIZE);
+    if (!block)
+        return NULL;
+    *(size_t*)block = size;
+
+    int phase = ProfileGetActivePhase();
+    if (phase < 0)
+        phase = ALLOC_NO_PHASE;
+    s_Frame[phase].count++;
+    s_Frame[phase].bytes += (uint32)size;
+    s_FrameTotal.count++;
+    s_FrameTotal.bytes += (uint32)size;
+    s_Total.count++;
+    s_Total.bytes += (uint32)size;
+
+    s_LiveBytes += (uint32)size;
+    if (s_LiveBytes > s_FramePeak)
+        s_FramePeak = s_LiveBytes;
+    if (s_LiveBytes > s_GamePeak)
+        s_GamePeak = s_LiveBytes;
+
+    RecordCallSite(caller, (uint32)size);
+    return block + ALLOC_HEADER_SIZE;
+}
+
+static void Free(void* p)
+{
+    if (!p)
+        return;
+
+    char* block = (char*)p - ALLOC_HEADER_SIZE;
+    s_LiveBytes -= (uint32)*(size_t*)block;
+    free(block);
+}
+
+void* operator new(size_t size)
+{
+    void* p = Allocate(size, __builtin_return_address(0));
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    void* p = Allocate(size, __builtin_return_address(0));
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, std::nothrow_t const &) throw()
+{
+    return Allocate(size, __builtin_return_address(0));
+}
+
+void* operator new[](size_t size, std::nothrow_t const &) throw()
+{
+    return Allocate(size, __builtin_return_address(0));
+}
+
+void operator delete(void* p) throw()
+{
+    Free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    Free(p);
+}
+
+void operator delete(void* p, std::nothrow_t const &) throw()
+{
+    Free(p);
+}
+
+void operator delete[](void* p, std::nothrow_t const &) throw()
+{
+    Free(p);
+}
+
+void AllocEndFrame()
+{
+    memcpy(s_LastFrame, s_Frame, sizeof(s_Frame));
+    s_LastFrameTotal = s_FrameTotal;
+    s_LastFramePeak = s_FramePeak;
+
+    memset(s_Frame, 0, sizeof(s_Frame));
+    memset(&s_FrameTotal, 0, sizeof(s_FrameTotal));
+    s_FramePeak = s_LiveBytes;
+
+    TraceCounter(TRACE_ALLOCATIONS, s_LastFrameTotal.count);
+}
+
+AllocCounts const & AllocGetFrameCounts(int phase)
+{
+    return s_LastFrame[phase];
+}
+
+AllocCounts const & AllocGetFrameTotal()
+{
+    return s_LastFrameTotal;
+}
+
+uint32 AllocGetFramePeakBytes()
+{
+    return s_LastFramePeak;
+}
+
+AllocCounts AllocGetTotal()
+{
+    return s_Total;
+}
+
+uint32 AllocGetLiveBytes()
+{
+    return s_LiveBytes;
+}
+
+void AllocBeginGame()
+{
+    s_GameStart = s_Total;
+    s_GamePeak = s_LiveBytes;
+}
+
+void AllocEndGame()
+{
+    s3eDebugTracePrintf("Game: %u allocations, %u bytes allocated, peak %u bytes live",
+        s_Total.count - s_GameStart.count, s_Total.bytes - s_GameStart.bytes, s_GamePeak);
+}
+
+void AllocReportCallSites()
+{
+    // Sort a copy of the table by number of allocations; it's small and this is only done on request
+    static AllocCallSite sorted[MAX_ALLOC_CALL_SITES];
+    int numSites = 0;
+    for (int i=0; i<MAX_ALLOC_CALL_SITES; i++)
+    {
+        if (!s_CallSites[i].address)
+            continue;
+
+        int j = numSites++;
+        for (; j>0 && sorted[j-1].counts.count < s_CallSites[i].counts.count; j--)
+            sorted[j] = sorted[j-1];
+        sorted[j] = s_CallSites[i];
+    }
+
+    s3eDebugTracePrintf("Allocations: %u in total, %u bytes live. Busiest call sites:", s_Total.count, s_LiveBytes);
+    for (int i=0; i<numSites && i<16; i++)
+        s3eDebugTracePrintf("  %p: %u allocations, %u bytes", sorted[i].address, sorted[i].counts.count, sorted[i].counts.bytes);
+    if (s_OtherSites.count)
+        s3eDebugTracePrintf("  other: %u allocations, %u bytes", s_OtherSites.count, s_OtherSites.bytes);
+}
+
+#endif // IW_DEBUG
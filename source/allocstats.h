@@ -0,0 +1,74 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _ALLOCSTATS_H
+#define _ALLOCSTATS_H
+
+#include "s3eTypes.h"
+#include "profile.h"
+
+// Heap allocation accounting.
+// Debug builds replace the global operator new and delete to count every allocation, the bytes allocated and the
+// number of bytes live. Each allocation is attributed to the innermost PROFILE_SCOPE phase it was made in (or to
+// ALLOC_NO_PHASE outside of any scope), and to the address it was called from.
+// The profile overlay shows allocations per frame for each phase, the M key prints the busiest call sites (resolve
+// the addresses with the map file or addr2line), and a summary is printed at the end of each game.
+// Allocation totals are also written to render captures, so they appear in the tools/softrender output.
+// In release builds nothing is counted and the functions do nothing.
+
+#define ALLOC_NO_PHASE          NUM_PROFILE_PHASES
+#define MAX_ALLOC_CALL_SITES    256
+
+struct AllocCounts
+{
+    uint32 count;   // Number of allocations
+    uint32 bytes;   // Bytes requested
+};
+
+#ifdef IW_DEBUG
+
+// Called once per frame, after the previous frame has finished
+void AllocEndFrame();
+
+// Allocations made during the previous frame, by phase (ALLOC_NO_PHASE for allocations outside any phase)
+AllocCounts const & AllocGetFrameCounts(int phase);
+
+// Allocations made during the previous frame in total, and the peak number of bytes live during it
+AllocCounts const & AllocGetFrameTotal();
+uint32 AllocGetFramePeakBytes();
+
+// Allocations made since startup
+AllocCounts AllocGetTotal();
+
+// Bytes currently allocated
+uint32 AllocGetLiveBytes();
+
+// Mark the start and end of a game, and print the allocations made during it
+void AllocBeginGame();
+void AllocEndGame();
+
+// Print the call sites which have made the most allocations
+void AllocReportCallSites();
+
+#else
+
+inline void AllocEndFrame() {}
+inline AllocCounts AllocGetTotal() { AllocCounts c = { 0, 0 }; return c; }
+inline uint32 AllocGetLiveBytes() { return 0; }
+inline void AllocBeginGame() {}
+inline void AllocEndGame() {}
+inline void AllocReportCallSites() {}
+
+#endif
+
+#endif /* !_ALLOCSTATS_H */
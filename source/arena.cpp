@@ -0,0 +1,45 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "arena.h"
+
+Arena::Arena(uint32 _capacity) : capacity(_capacity), used(0), peak(0)
+{
+    buffer = new char[capacity];
+}
+
+Arena::~Arena()
+{
+    delete [] buffer;
+}
+
+void* Arena::Alloc(uint32 size, uint32 align)
+{
+    uint32 start = (used + align - 1) & ~(align - 1);
+    if (start + size > capacity)
+    {
+        IwAssertMsg(APP, false, ("Arena is full (%d of %d bytes used, %d requested)", used, capacity, size));
+        return NULL;
+    }
+
+    used = start + size;
+    if (used > peak)
+        peak = used;
+    return buffer + start;
+}
+
+void Arena::Rewind(uint32 mark)
+{
+    IwAssertMsg(APP, mark <= used, ("Arena rewound past its end"));
+    used = mark;
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include "s3eTypes.h"
+#include "IwDebug.h"
+
+#include <new>
+
+// Fixed-capacity bump allocator.
+// The memory is allocated once when the arena is created. Allocations are taken from it in order and can't be freed
+// individually; instead the arena is rewound to an earlier mark (see ArenaScope) or reset completely. Running out of
+// space is a bug (the capacity should be chosen so it can't happen), and asserts.
+class Arena
+{
+    char* buffer;
+    uint32 capacity;
+    uint32 used;
+    uint32 peak;
+
+public:
+    Arena(uint32 _capacity);
+    ~Arena();
+
+    // Returns NULL if there isn't enough space
+    void* Alloc(uint32 size, uint32 align = 8);
+
+    // Allocate and default-construct an array. The destructors are never called, so T should be a plain type
+    template <class T> T* AllocArray(int count)
+    {
+        T* p = (T*)Alloc(count * sizeof(T));
+        if (p)
+            for (int i=0; i<count; i++)
+                new (p + i) T;
+        return p;
+    }
+
+    uint32 GetMark() const { return used; }
+    void Rewind(uint32 mark);
+    void Reset() { Rewind(0); }
+
+    uint32 GetUsed() const { return used; }
+    uint32 GetPeak() const { return peak; }
+    uint32 GetCapacity() const { return capacity; }
+};
+
+// Scratch space: allocations made from the arena while the scope is alive are released when it ends
+struct ArenaScope
+{
+    Arena& arena;
+    uint32 mark;
+
+    ArenaScope(Arena& _arena) : arena(_arena), mark(_arena.GetMark()) {}
+    ~ArenaScope() { arena.Rewind(mark); }
+};
+
+#endif /* !_ARENA_H */
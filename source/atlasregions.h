@@ -0,0 +1,104 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+// Generated by tools/makeatlas.py - do not edit.
+// Position of each packed image (IMAGE_STAR onwards, in RenderImageId order) in the atlas for each tile size.
+
+#ifndef _ATLASREGIONS_H
+#define _ATLASREGIONS_H
+
+#define NUM_ATLAS_SIZES 5
+#define NUM_ATLAS_REGIONS 12
+
+static const int g_AtlasTileSizes[NUM_ATLAS_SIZES] = { 12, 16, 24, 32, 48 };
+
+static const RenderAtlasRegion g_AtlasRegions[NUM_ATLAS_SIZES][NUM_ATLAS_REGIONS] =
+{
+    // atlas12
+    {
+        { 0, 0, 64, 64 },
+        { 198, 66, 48, 48 },
+        { 0, 132, 48, 48 },
+        { 150, 132, 48, 48 },
+        { 50, 132, 48, 48 },
+        { 100, 132, 48, 48 },
+        { 200, 132, 48, 48 },
+        { 66, 66, 64, 64 },
+        { 132, 66, 64, 64 },
+        { 132, 0, 64, 64 },
+        { 66, 0, 64, 64 },
+        { 0, 66, 64, 64 },
+    },
+    // atlas16
+    {
+        { 0, 0, 64, 64 },
+        { 0, 66, 64, 64 },
+        { 0, 132, 64, 64 },
+        { 0, 330, 64, 64 },
+        { 0, 198, 64, 64 },
+        { 0, 264, 64, 64 },
+        { 0, 396, 64, 64 },
+        { 0, 660, 64, 64 },
+        { 0, 726, 64, 64 },
+        { 0, 528, 64, 64 },
+        { 0, 462, 64, 64 },
+        { 0, 594, 64, 64 },
+    },
+    // atlas24
+    {
+        { 0, 294, 64, 64 },
+        { 0, 0, 96, 96 },
+        { 98, 0, 96, 96 },
+        { 0, 196, 96, 96 },
+        { 0, 98, 96, 96 },
+        { 98, 98, 96, 96 },
+        { 98, 196, 96, 96 },
+        { 66, 360, 64, 64 },
+        { 132, 360, 64, 64 },
+        { 132, 294, 64, 64 },
+        { 66, 294, 64, 64 },
+        { 0, 360, 64, 64 },
+    },
+    // atlas32
+    {
+        { 390, 130, 64, 64 },
+        { 0, 0, 128, 128 },
+        { 130, 0, 128, 128 },
+        { 130, 130, 128, 128 },
+        { 260, 0, 128, 128 },
+        { 0, 130, 128, 128 },
+        { 260, 130, 128, 128 },
+        { 198, 260, 64, 64 },
+        { 264, 260, 64, 64 },
+        { 66, 260, 64, 64 },
+        { 0, 260, 64, 64 },
+        { 132, 260, 64, 64 },
+    },
+    // atlas48
+    {
+        { 388, 388, 64, 64 },
+        { 0, 0, 192, 192 },
+        { 194, 0, 192, 192 },
+        { 0, 388, 192, 192 },
+        { 0, 194, 192, 192 },
+        { 194, 194, 192, 192 },
+        { 194, 388, 192, 192 },
+        { 198, 582, 64, 64 },
+        { 264, 582, 64, 64 },
+        { 66, 582, 64, 64 },
+        { 0, 582, 64, 64 },
+        { 132, 582, 64, 64 },
+    },
+};
+
+#endif /* !_ATLASREGIONS_H */
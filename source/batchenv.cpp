@@ -0,0 +1,618 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "batchenv.h"
+#include "boardrules.h"
+#include "gameparams.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// Each cell holds the tile's colour in the low bits and its connections (ConnectFlags) in the high bits
+#define CELL_COLOUR_MASK    0x0f
+#define CELL_CONNECT_SHIFT  4
+
+// A piece's tiles in one rotation, relative to the top-left of its PIECE_SIZE square
+struct PlacedPiece
+{
+    int x[4], y[4];
+    uint8_t connect[4];
+    int minX, maxX, minY;
+};
+
+// Scalar state of one game, copied out of the arrays while it's being stepped
+struct EnvGame
+{
+    int32_t score, level, pieceCount;
+    int32_t activeType, activeColour, nextType, nextColour;
+    GameRandom random;
+    bool over;
+    GameParams const * params;
+};
+
+// Groups of tiles of the same colour, as found by BoardCreateGroups
+struct Groups
+{
+    int numGroups;
+    int16_t ids[MAX_GAME_CELLS];        // Group of each tile (-1 for empty cells)
+    int sizes[MAX_GAME_CELLS];          // Number of tiles in each group
+    int starts[MAX_GAME_CELLS];         // Where each group's tiles are in 'tiles'
+    int tiles[MAX_GAME_CELLS];          // Tiles of each group, group by group
+    int fallScratch[MAX_GAME_CELLS*4 + 1];  // Scratch space for BoardMakeFall
+};
+
+// Working space for playing a piece. This is about 1MB with BLOCSLOT_MEGA_BOARD, which is more than the stack of a
+// secondary thread can be relied on to hold (512KB on macOS), so each thread has one on the heap
+struct EnvScratch
+{
+    Groups groups;
+    uint8_t cells[MAX_GAME_CELLS];      // Copy of a game's cells, for BlocslotEnvTryAction
+};
+
+// A game's cells and group ids, as the algorithms in boardrules.h see them
+template <class Size>
+struct EnvBoard
+{
+    Size size;
+    uint8_t* cells;
+    int16_t* ids;
+
+    EnvBoard(Size _size, uint8_t* _cells, int16_t* _ids) : size(_size), cells(_cells), ids(_ids) {}
+    int Width() const { return size.Width(); }
+    int Height() const { return size.Height(); }
+    int Colour(int i) const { return cells[i] & CELL_COLOUR_MASK; }
+    uint32_t Connections(int i) const { return cells[i] >> CELL_CONNECT_SHIFT; }
+    void SetConnections(int i, uint32_t connect) { cells[i] = (uint8_t)((cells[i] & CELL_COLOUR_MASK) | (connect << CELL_CONNECT_SHIFT)); }
+    int GroupId(int i) const { return ids[i]; }
+    void SetGroupId(int i, int id) { ids[i] = (int16_t)id; }
+
+    void MoveDown(int i)
+    {
+        int below = i + size.Width();
+        cells[below] = cells[i];
+        ids[below] = ids[i];
+        cells[i] = 0;
+        ids[i] = -1;
+    }
+};
+
+// The functions which play games of one board size
+struct BoardKernels
+{
+    void (*stepGames)(BlocslotEnv* env, int first, int last, EnvScratch* scratch);
+    bool (*tryAction)(BlocslotEnv const* env, int index, int column, int rotation, uint8_t* board, int32_t* reward, uint8_t* done);
+    void (*resetGame)(BlocslotEnv* env, int index, uint32_t seed);
+};
+
+struct BlocslotEnv
+{
+    int numEnvs;
+    GameParams params;
+    BoardKernels const * kernels;
+
+    // Game state, one entry per game (cells and boards have room for the largest board for each game, but are packed
+    // at the current size)
+    uint8_t* cells;
+    int32_t* score;
+    int32_t* level;
+    int32_t* pieceCount;
+    int32_t* activeType;
+    int32_t* activeColour;
+    int32_t* nextType;
+    int32_t* nextColour;
+    uint32_t* random;
+    uint8_t* done;
+    uint8_t* invalid;
+    uint8_t* boards;
+
+    // Scratch space for each thread stepping the games (the calling thread's first), and for BlocslotEnvTryAction,
+    // which can be called from any thread (one call at a time)
+    std::vector<EnvScratch*> scratch;
+    EnvScratch* tryScratch;
+    mutable std::mutex tryMutex;
+
+    // Worker threads, each of which steps a range of the games
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable startWork;
+    std::condition_variable workDone;
+    int generation;
+    int numBusy;
+    bool quit;
+    const int32_t* actions;
+    int32_t* rewards;
+};
+
+//
+// Rules ////////////////////////////////////////////////////////////////////////
+//
+// The board algorithms are the ones the game's Grid uses (boardrules.h), and the rest follows PuzzleGame step for step,
+// so that the scores are the same.
+
+static void GetPiece(int type, int rotation, PlacedPiece& piece)
+{
+    PieceShape const & shape = pieceShapes[type];
+    int r = ((rotation % shape.numRotations) + shape.numRotations) % shape.numRotations;
+
+    piece.minX = piece.minY = PIECE_SIZE;
+    piece.maxX = -1;
+    for (int i=0; i<4; i++)
+    {
+        int x = shape.tiles[i][0];
+        int y = shape.tiles[i][1];
+
+        // Each rotation moves the tile at (x,y) to (PIECE_SIZE-1-y, x), as Grid::Rotate does
+        for (int j=0; j<r; j++)
+        {
+            int t = x;
+            x = PIECE_SIZE-1-y;
+            y = t;
+        }
+        piece.x[i] = x;
+        piece.y[i] = y;
+        piece.minX = x < piece.minX ? x : piece.minX;
+        piece.maxX = x > piece.maxX ? x : piece.maxX;
+        piece.minY = y < piece.minY ? y : piece.minY;
+    }
+
+    // The tiles of a piece are all connected to each other
+    for (int i=0; i<4; i++)
+    {
+        piece.connect[i] = 0;
+        for (int j=0; j<4; j++)
+        {
+            if (piece.x[j] == piece.x[i]-1 && piece.y[j] == piece.y[i])
+                piece.connect[i] |= CONNECT_LEFT;
+            if (piece.x[j] == piece.x[i]+1 && piece.y[j] == piece.y[i])
+                piece.connect[i] |= CONNECT_RIGHT;
+            if (piece.x[j] == piece.x[i] && piece.y[j] == piece.y[i]-1)
+                piece.connect[i] |= CONNECT_UP;
+            if (piece.x[j] == piece.x[i] && piece.y[j] == piece.y[i]+1)
+                piece.connect[i] |= CONNECT_DOWN;
+        }
+    }
+}
+
+template <class Size>
+static bool Collide(Size size, const uint8_t* cells, PlacedPiece const & piece, int ox, int oy)
+{
+    int width = size.Width();
+    int height = size.Height();
+
+    for (int i=0; i<4; i++)
+    {
+        int x = piece.x[i] + ox;
+        int y = piece.y[i] + oy;
+        if (x < 0 || x >= width || y < 0 || y >= height || cells[y*width + x])
+            return true;
+    }
+    return false;
+}
+
+// Grid::CheckForExplosions and PuzzleGame::Explode, for a whole chain of explosions. Removing a group doesn't change
+// any of the others, so every group big enough is removed and scored in turn (in the order the game removes them)
+// without finding the groups again
+static void ExplodeGroups(uint8_t* cells, Groups& groups, EnvGame& game, int& multiplier)
+{
+    int threshold = game.params->explodeThreshold;
+    for (int id = BoardNextExplosion(groups.sizes, groups.numGroups, threshold, -1); id != -1;
+        id = BoardNextExplosion(groups.sizes, groups.numGroups, threshold, id))
+    {
+        int c = groups.sizes[id];
+        const int* tiles = groups.tiles + groups.starts[id];
+        for (int i=0; i<c; i++)
+        {
+            cells[tiles[i]] = 0;
+            groups.ids[tiles[i]] = -1;
+        }
+
+        game.score += ExplosionScore(*game.params, c) * multiplier;
+        if (multiplier < game.params->maxMultiplier)
+            multiplier *= 2;
+    }
+}
+
+// PuzzleGame::CreateRandomPiece
+static void CreateRandomPiece(EnvGame& game)
+{
+    game.nextType = game.random.Range(0, NUM_PIECE_TYPES);
+    game.nextColour = game.random.Range(1, game.params->colours[game.level]+1);
+}
+
+// PuzzleGame::NewPiece
+template <class Size>
+static void NewPiece(Size size, const uint8_t* cells, EnvGame& game)
+{
+    int width = size.Width();
+
+    game.activeType = game.nextType;
+    game.activeColour = game.nextColour;
+
+    game.pieceCount++;
+    if (game.level < MAX_LEVEL && game.pieceCount > game.params->levelPieces[game.level])
+        game.level++;
+
+    CreateRandomPiece(game);
+
+    // The piece appears in the middle, touching the top of the play area
+    PlacedPiece piece;
+    GetPiece(game.activeType, 0, piece);
+    if (Collide(size, cells, piece, (width - PIECE_SIZE)/2, -piece.minY))
+        game.over = true;
+}
+
+template <class Size>
+static void StartGame(Size size, uint8_t* cells, EnvGame& game, uint32_t seed)
+{
+    memset(cells, 0, size.Cells());
+    game.score = 0;
+    game.pieceCount = 0;
+    game.level = 1;
+    game.over = false;
+    game.random.Seed(seed);
+    CreateRandomPiece(game);
+    NewPiece(size, cells, game);
+}
+
+// Place the active piece, and resolve everything that happens until the next piece appears.
+// Returns false if the action wasn't possible
+template <class Size>
+static bool PlayPiece(Size size, uint8_t* cells, EnvGame& game, int column, int rotation, Groups& groups)
+{
+    int width = size.Width();
+
+    PlacedPiece piece;
+    GetPiece(game.activeType, rotation, piece);
+    int ox = column - piece.minX;
+    int oy = -piece.minY;
+
+    bool valid = !Collide(size, cells, piece, ox, oy);
+    if (!valid)
+    {
+        GetPiece(game.activeType, 0, piece);
+        ox = (width - PIECE_SIZE)/2;
+        oy = -piece.minY;
+    }
+
+    // Drop, and land (PuzzleGame::LandPiece)
+    while (!Collide(size, cells, piece, ox, oy+1))
+        oy++;
+    for (int i=0; i<4; i++)
+        cells[(piece.y[i]+oy)*width + piece.x[i]+ox] = (uint8_t)(game.activeColour | (piece.connect[i] << CELL_CONNECT_SHIFT));
+    EnvBoard<Size> board(size, cells, groups.ids);
+    game.score += LandingScore(*game.params, BoardUpdateConnections(board));
+
+    // The exploding and falling modes of PuzzleGame::Update, without the delays. Once everything has landed, the groups
+    // are found again and the loop ends if nothing explodes, as then nothing can fall either
+    int multiplier = 1;
+    while (1)
+    {
+        groups.numGroups = BoardCreateGroups(board, groups.sizes, groups.starts, groups.tiles);
+        ExplodeGroups(cells, groups, game, multiplier);
+
+        if (!BoardMakeFall(board, groups.numGroups, groups.fallScratch))
+            break;
+        while (BoardMakeFall(board, groups.numGroups, groups.fallScratch))
+            ;
+
+        BoardUpdateConnections(board);
+    }
+
+    NewPiece(size, cells, game);
+    return valid;
+}
+
+//
+// Batches ////////////////////////////////////////////////////////////////////////
+//
+
+static void Load(BlocslotEnv const* env, int i, EnvGame& game)
+{
+    game.score = env->score[i];
+    game.level = env->level[i];
+    game.pieceCount = env->pieceCount[i];
+    game.activeType = env->activeType[i];
+    game.activeColour = env->activeColour[i];
+    game.nextType = env->nextType[i];
+    game.nextColour = env->nextColour[i];
+    game.random.state = env->random[i];
+    game.over = env->done[i] != 0;
+    game.params = &env->params;
+}
+
+template <class Size>
+static void Store(Size size, BlocslotEnv* env, int i, EnvGame const & game)
+{
+    env->score[i] = game.score;
+    env->level[i] = game.level;
+    env->pieceCount[i] = game.pieceCount;
+    env->activeType[i] = game.activeType;
+    env->activeColour[i] = game.activeColour;
+    env->nextType[i] = game.nextType;
+    env->nextColour[i] = game.nextColour;
+    env->random[i] = game.random.state;
+    env->done[i] = game.over;
+
+    const uint8_t* cells = env->cells + i*size.Cells();
+    uint8_t* board = env->boards + i*size.Cells();
+    for (int j=0; j<size.Cells(); j++)
+        board[j] = cells[j] & CELL_COLOUR_MASK;
+}
+
+template <class Size>
+static void StepGames(BlocslotEnv* env, int first, int last, EnvScratch* scratch)
+{
+    Size size(env->params.width, env->params.height);
+    for (int i=first; i<last; i++)
+    {
+        EnvGame game;
+        Load(env, i, game);
+        int oldScore = game.score;
+
+        if (!game.over)
+        {
+            uint8_t* cells = env->cells + i*size.Cells();
+            env->invalid[i] = !PlayPiece(size, cells, game, env->actions[i*2], env->actions[i*2+1], scratch->groups);
+            Store(size, env, i, game);
+        }
+
+        if (env->rewards)
+            env->rewards[i] = game.score - oldScore;
+    }
+}
+
+template <class Size>
+static bool TryGame(BlocslotEnv const* env, int index, int column, int rotation, uint8_t* board, int32_t* reward, uint8_t* done)
+{
+    Size size(env->params.width, env->params.height);
+
+    // Play it on copies of the game
+    std::lock_guard<std::mutex> lock(env->tryMutex);
+    uint8_t* cells = env->tryScratch->cells;
+    memcpy(cells, env->cells + index*size.Cells(), size.Cells());
+    EnvGame game;
+    Load(env, index, game);
+    int oldScore = game.score;
+    bool valid = PlayPiece(size, cells, game, column, rotation, env->tryScratch->groups);
+
+    if (board)
+        for (int j=0; j<size.Cells(); j++)
+            board[j] = cells[j] & CELL_COLOUR_MASK;
+    if (reward)
+        *reward = game.score - oldScore;
+    if (done)
+        *done = game.over;
+    return valid;
+}
+
+template <class Size>
+static void ResetGame(BlocslotEnv* env, int index, uint32_t seed)
+{
+    Size size(env->params.width, env->params.height);
+
+    EnvGame game;
+    game.params = &env->params;
+    StartGame(size, env->cells + index*size.Cells(), game, seed);
+    Store(size, env, index, game);
+    env->invalid[index] = 0;
+}
+
+static const BoardKernels s_DefaultSizeKernels = { StepGames<DefaultBoardSize>, TryGame<DefaultBoardSize>, ResetGame<DefaultBoardSize> };
+static const BoardKernels s_AnySizeKernels = { StepGames<RuntimeBoardSize>, TryGame<RuntimeBoardSize>, ResetGame<RuntimeBoardSize> };
+
+// Boards of the default size are played by kernels compiled for it, others by kernels which take the size at runtime
+static BoardKernels const * SelectKernels(GameParams const & params)
+{
+    if (params.width == DEFAULT_GAME_WIDTH && params.height == DEFAULT_GAME_HEIGHT)
+        return &s_DefaultSizeKernels;
+    return &s_AnySizeKernels;
+}
+
+static void StepRange(BlocslotEnv* env, int thread, int first, int last)
+{
+    env->kernels->stepGames(env, first, last, env->scratch[thread]);
+}
+
+static void WorkerFunc(BlocslotEnv* env, int index, int numThreads)
+{
+    int generation = 0;
+    while (1)
+    {
+        {
+            std::unique_lock<std::mutex> lock(env->mutex);
+            env->startWork.wait(lock, [&] { return env->quit || env->generation != generation; });
+            if (env->quit)
+                return;
+            generation = env->generation;
+        }
+
+        StepRange(env, index, env->numEnvs * index / numThreads, env->numEnvs * (index+1) / numThreads);
+
+        std::lock_guard<std::mutex> lock(env->mutex);
+        if (--env->numBusy == 0)
+            env->workDone.notify_one();
+    }
+}
+
+BlocslotEnv* BlocslotEnvCreate(int numEnvs, int numThreads)
+{
+    if (numEnvs <= 0)
+        return NULL;
+    if (numThreads < 1)
+        numThreads = 1;
+    if (numThreads > numEnvs)
+        numThreads = numEnvs;
+
+    BlocslotEnv* env = new (std::nothrow) BlocslotEnv;
+    if (!env)
+        return NULL;
+
+    env->numEnvs = numEnvs;
+    env->params = g_DefaultGameParams;
+    env->kernels = SelectKernels(env->params);
+    env->cells = (uint8_t*)calloc(numEnvs, MAX_GAME_CELLS);
+    env->boards = (uint8_t*)calloc(numEnvs, MAX_GAME_CELLS);
+    env->score = (int32_t*)calloc(numEnvs, sizeof(int32_t));
+    env->level = (int32_t*)calloc(numEnvs, sizeof(int32_t));
+    env->pieceCount = (int32_t*)calloc(numEnvs, sizeof(int32_t));
+    env->activeType = (int32_t*)calloc(numEnvs, sizeof(int32_t));
+    env->activeColour = (int32_t*)calloc(numEnvs, sizeof(int32_t));
+    env->nextType = (int32_t*)calloc(numEnvs, sizeof(int32_t));
+    env->nextColour = (int32_t*)calloc(numEnvs, sizeof(int32_t));
+    env->random = (uint32_t*)calloc(numEnvs, sizeof(uint32_t));
+    env->done = (uint8_t*)calloc(numEnvs, 1);
+    env->invalid = (uint8_t*)calloc(numEnvs, 1);
+    env->generation = 0;
+    env->numBusy = 0;
+    env->quit = false;
+    env->actions = NULL;
+    env->rewards = NULL;
+    for (int t=0; t<numThreads; t++)
+        env->scratch.push_back((EnvScratch*)malloc(sizeof(EnvScratch)));
+    env->tryScratch = (EnvScratch*)malloc(sizeof(EnvScratch));
+
+    bool haveScratch = env->tryScratch != NULL;
+    for (int t=0; t<numThreads; t++)
+        haveScratch = haveScratch && env->scratch[t];
+
+    if (!haveScratch || !env->cells || !env->boards || !env->score || !env->level || !env->pieceCount || !env->activeType || !env->activeColour
+        || !env->nextType || !env->nextColour || !env->random || !env->done || !env->invalid)
+    {
+        BlocslotEnvDestroy(env);
+        return NULL;
+    }
+
+    // Every game starts over until it's reset
+    memset(env->done, 1, numEnvs);
+
+    // The calling thread steps the first range itself
+    for (int t=1; t<numThreads; t++)
+        env->threads.push_back(std::thread(WorkerFunc, env, t, numThreads));
+
+    return env;
+}
+
+void BlocslotEnvDestroy(BlocslotEnv* env)
+{
+    if (!env)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(env->mutex);
+        env->quit = true;
+    }
+    env->startWork.notify_all();
+    for (size_t t=0; t<env->threads.size(); t++)
+        env->threads[t].join();
+
+    free(env->cells);
+    free(env->boards);
+    free(env->score);
+    free(env->level);
+    free(env->pieceCount);
+    free(env->activeType);
+    free(env->activeColour);
+    free(env->nextType);
+    free(env->nextColour);
+    free(env->random);
+    free(env->done);
+    free(env->invalid);
+    for (size_t t=0; t<env->scratch.size(); t++)
+        free(env->scratch[t]);
+    free(env->tryScratch);
+    delete env;
+}
+
+int BlocslotEnvGetCount(BlocslotEnv const* env)
+{
+    return env->numEnvs;
+}
+
+void BlocslotEnvGetObservations(BlocslotEnv const* env, BlocslotObservations* obs)
+{
+    obs->boards = env->boards;
+    obs->activeType = env->activeType;
+    obs->activeColour = env->activeColour;
+    obs->nextType = env->nextType;
+    obs->nextColour = env->nextColour;
+    obs->score = env->score;
+    obs->level = env->level;
+    obs->pieces = env->pieceCount;
+    obs->done = env->done;
+    obs->invalid = env->invalid;
+}
+
+void BlocslotEnvResetOne(BlocslotEnv* env, int index, uint32_t seed)
+{
+    if (index < 0 || index >= env->numEnvs)
+        return;
+
+    env->kernels->resetGame(env, index, seed);
+}
+
+int BlocslotEnvSetParams(BlocslotEnv* env, const char* text, char* error, int errorSize)
+{
+    GameParams params = g_DefaultGameParams;
+    if (!GameParamsParse(params, text, error, errorSize))
+        return 0;
+
+    // The games in progress may be on a different size of board, so they're ended
+    env->params = params;
+    env->kernels = SelectKernels(params);
+    memset(env->done, 1, env->numEnvs);
+    return 1;
+}
+
+void BlocslotEnvGetBoardSize(BlocslotEnv const* env, int* width, int* height)
+{
+    *width = env->params.width;
+    *height = env->params.height;
+}
+
+int BlocslotEnvTryAction(BlocslotEnv const* env, int index, int32_t column, int32_t rotation, uint8_t* board, int32_t* reward, uint8_t* done)
+{
+    if (index < 0 || index >= env->numEnvs || env->done[index])
+        return 0;
+
+    return env->kernels->tryAction(env, index, column, rotation, board, reward, done);
+}
+
+void BlocslotEnvReset(BlocslotEnv* env, const uint32_t* seeds)
+{
+    for (int i=0; i<env->numEnvs; i++)
+        BlocslotEnvResetOne(env, i, seeds[i]);
+}
+
+void BlocslotEnvStep(BlocslotEnv* env, const int32_t* actions, int32_t* rewards)
+{
+    int numThreads = (int)env->threads.size() + 1;
+
+    {
+        std::lock_guard<std::mutex> lock(env->mutex);
+        env->actions = actions;
+        env->rewards = rewards;
+        env->numBusy = numThreads - 1;
+        env->generation++;
+    }
+    env->startWork.notify_all();
+
+    StepRange(env, 0, 0, env->numEnvs / numThreads);
+
+    std::unique_lock<std::mutex> lock(env->mutex);
+    env->workDone.wait(lock, [&] { return env->numBusy == 0; });
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _BATCHENV_H
+#define _BATCHENV_H
+
+#include <stdint.h>
+
+// Batch environment for training and evaluating AI players.
+// Steps many independent games at once, with a plain C interface so it can be loaded from other languages. Each step
+// places every game's piece directly (the action is the column of the piece's leftmost tile, and its rotation), drops
+// it, and then resolves the explosions and falls it causes straight away, rather than over time as in the game.
+// The rules are the game's own (gamerules.h), played with the default parameters (gameparams.h) unless others are set. The state of all the games is kept as a structure of arrays, and the
+// games are divided between worker threads. Boards of the default size are played by code compiled for that size;
+// other sizes go through the same code with the size given at runtime.
+//
+// This is a host library and doesn't use the Marmalade SDK. Build it with, for example:
+//   c++ -O2 -std=c++11 -shared -fPIC -Isource source/batchenv.cpp source/boardfeatures.cpp source/gameparams.cpp -o libblocslotenv.so -lpthread
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct BlocslotEnv BlocslotEnv;
+
+// Observation buffers, each with one entry per game. They stay valid until the environment is destroyed
+typedef struct BlocslotObservations
+{
+    const uint8_t* boards;          // width * height tile colours per game (0 = empty), row by row from the top
+    const int32_t* activeType;      // Piece to be placed (see pieceShapes) and its colour
+    const int32_t* activeColour;
+    const int32_t* nextType;        // Piece after that
+    const int32_t* nextColour;
+    const int32_t* score;
+    const int32_t* level;
+    const uint8_t* done;            // Non-zero once the game is over
+    const uint8_t* invalid;         // Non-zero if the last action couldn't be played. The piece is dropped unrotated from
+                                    // where it appears in the game instead
+    const int32_t* pieces;          // Number of pieces played, including the one to be placed
+} BlocslotObservations;
+
+// 'numThreads' includes the calling thread. Returns NULL if the environment couldn't be created
+BlocslotEnv* BlocslotEnvCreate(int numEnvs, int numThreads);
+void BlocslotEnvDestroy(BlocslotEnv* env);
+
+int BlocslotEnvGetCount(BlocslotEnv const* env);
+void BlocslotEnvGetObservations(BlocslotEnv const* env, BlocslotObservations* obs);
+
+// Play every game with the parameters in the text of a parameter file (see gameparams.h); settings it doesn't give
+// have their default values. This ends the games in progress, so they need to be reset afterwards. Returns 0, with a
+// description in 'error', if the text can't be used
+int BlocslotEnvSetParams(BlocslotEnv* env, const char* text, char* error, int errorSize);
+
+// Size of the board the games are played on (set by the parameters)
+void BlocslotEnvGetBoardSize(BlocslotEnv const* env, int* width, int* height);
+
+// Start a new game in every environment, or in one
+void BlocslotEnvReset(BlocslotEnv* env, const uint32_t* seeds);
+void BlocslotEnvResetOne(BlocslotEnv* env, int index, uint32_t seed);
+
+// Play one piece in every game which isn't over. 'actions' holds a column and rotation for each game. 'rewards'
+// (optional) receives the score gained by each game
+void BlocslotEnvStep(BlocslotEnv* env, const int32_t* actions, int32_t* rewards);
+
+// Find out what an action would do to one game, without playing it. Receives the board afterwards, the score gained and
+// whether the game would be over (each is optional). Returns 0 if the action couldn't be played (see 'invalid'), or the
+// game is already over. It can be called from any thread, though calls from several threads at once take turns
+int BlocslotEnvTryAction(BlocslotEnv const* env, int index, int32_t column, int32_t rotation, uint8_t* board, int32_t* reward, uint8_t* done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !_BATCHENV_H */
@@ -0,0 +1,337 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "boardfeatures.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Each row is packed into 32 bits, so the features can't be found for the largest boards BLOCSLOT_MEGA_BOARD allows
+#if MAX_GAME_WIDTH > 32
+#error "Board features need rows of no more than 32 tiles"
+#endif
+
+// A board as bitmasks, one per row. Bit x is set if column x of the row has a tile (of the colour)
+struct PackedBoard
+{
+    uint32_t occupied[MAX_GAME_HEIGHT];
+    uint32_t rows[MAX_NUM_COLOURS][MAX_GAME_HEIGHT];
+};
+
+// The builtin is a library call unless the target has an instruction for it
+static inline int CountBits(uint32_t v)
+{
+#if defined(__GNUC__) && (defined(__POPCNT__) || defined(__aarch64__))
+    return __builtin_popcount(v);
+#else
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    return (((v + (v >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+#endif
+}
+
+static inline int LowestBit(uint32_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(v);
+#else
+    int n = 0;
+    while (!(v & 1))
+    {
+        v >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Gather bit 'plane' of each of 8 bytes into the low 8 bits
+static inline uint32_t GatherBits(uint64_t bytes, int plane)
+{
+    return (uint32_t)((((bytes >> plane) & 0x0101010101010101ull) * 0x0102040810204080ull) >> 56);
+}
+
+// Pack a row at a time. The colours (1 to 7) are split into 3 bit planes, 8 tiles at once, and each colour's mask is
+// then combined from the planes
+template <class Size>
+static void Pack(Size size, const uint8_t* board, PackedBoard& packed)
+{
+    int width = size.Width();
+    for (int y=0; y<size.Height(); y++)
+    {
+        const uint8_t* row = board + y*width;
+        uint32_t planes[3] = {0, 0, 0};
+        for (int x=0; x<width; x+=8)
+        {
+            uint64_t bytes = 0;
+            memcpy(&bytes, row + x, width - x < 8 ? width - x : 8);
+            for (int p=0; p<3; p++)
+                planes[p] |= GatherBits(bytes, p) << x;
+        }
+
+        packed.occupied[y] = planes[0] | planes[1] | planes[2];
+        for (int c=0; c<MAX_NUM_COLOURS; c++)
+        {
+            uint32_t mask = packed.occupied[y];
+            for (int p=0; p<3; p++)
+                mask &= ((c+1) >> p) & 1 ? planes[p] : ~planes[p];
+            packed.rows[c][y] = mask;
+        }
+    }
+}
+
+// Most runs of tiles a row can hold, and so the most groups there can be of one colour
+#define MAX_ROW_RUNS    ((MAX_GAME_WIDTH + 1) / 2)
+#define MAX_RUNS        (MAX_ROW_RUNS * MAX_GAME_HEIGHT)
+
+static int FindRoot(int* parent, int i)
+{
+    while (parent[i] != i)
+        i = parent[i] = parent[parent[i]];
+    return i;
+}
+
+// Find the groups of one colour. Each row is split into runs of adjacent tiles, and runs which touch a run in the row
+// above are merged with it. Fills in the size of each group and returns the number of groups
+template <class Size>
+static int FindGroups(Size size, const uint32_t* rows, int* sizes)
+{
+    uint32_t runs[MAX_RUNS];
+    int parent[MAX_RUNS];
+    int numRuns = 0;
+    int prevFirst = 0, prevEnd = 0;
+
+    for (int y=0; y<size.Height(); y++)
+    {
+        int first = numRuns;
+        for (uint32_t m = rows[y]; m; )
+        {
+            // Adding the lowest bit carries through the lowest run
+            uint32_t run = m & ~(m + (m & (0u - m)));
+            m &= ~run;
+
+            int i = numRuns++;
+            runs[i] = run;
+            parent[i] = i;
+            sizes[i] = CountBits(run);
+
+            for (int j=prevFirst; j<prevEnd; j++)
+            {
+                if (!(runs[j] & run))
+                    continue;
+
+                int a = FindRoot(parent, i);
+                int b = FindRoot(parent, j);
+                if (a != b)
+                {
+                    parent[a] = b;
+                    sizes[b] += sizes[a];
+                }
+            }
+        }
+        prevFirst = first;
+        prevEnd = numRuns;
+    }
+
+    int numGroups = 0;
+    for (int i=0; i<numRuns; i++)
+        if (parent[i] == i)
+            sizes[numGroups++] = sizes[i];
+    return numGroups;
+}
+
+template <class Size>
+static void BoardFeatures(Size size, PackedBoard const & packed, int explodeThreshold, int32_t* features)
+{
+    int height = size.Height();
+
+    // Work down the rows, tracking which columns have had a tile so far
+    uint32_t covered = 0;
+    int holes = 0;
+    int overhangs = 0;
+    for (int x=0; x<MAX_GAME_WIDTH; x++)
+        features[FEATURE_HEIGHT + x] = 0;
+    for (int y=0; y<height; y++)
+    {
+        uint32_t occupied = packed.occupied[y];
+        for (uint32_t tops = occupied & ~covered; tops; tops &= tops - 1)
+            features[FEATURE_HEIGHT + LowestBit(tops)] = height - y;
+
+        holes += CountBits(covered & ~occupied);
+        if (y > 0)
+            overhangs += CountBits(packed.occupied[y-1] & ~occupied);
+        covered |= occupied;
+    }
+    features[FEATURE_HOLES] = holes;
+    features[FEATURE_OVERHANGS] = overhangs;
+
+    // The colours don't overlap, so the pairs of every colour can be combined before they're counted
+    int connections = 0;
+    for (int y=0; y<height; y++)
+    {
+        uint32_t pairs = 0;
+        uint32_t below = 0;
+        for (int c=0; c<MAX_NUM_COLOURS; c++)
+        {
+            uint32_t row = packed.rows[c][y];
+            pairs |= row & (row >> 1);
+            if (y < height-1)
+                below |= row & packed.rows[c][y+1];
+        }
+        connections += CountBits(pairs) + CountBits(below);
+    }
+
+    int nearExplode = 0;
+    for (int c=0; c<MAX_NUM_COLOURS; c++)
+    {
+        const uint32_t* rows = packed.rows[c];
+        int sizes[MAX_RUNS];
+        int numGroups = FindGroups(size, rows, sizes);
+        int largest = 0;
+        for (int i=0; i<numGroups; i++)
+        {
+            if (sizes[i] > largest)
+                largest = sizes[i];
+            if (sizes[i] >= explodeThreshold - NEAR_EXPLODE_MARGIN && sizes[i] < explodeThreshold)
+                nearExplode++;
+        }
+        features[FEATURE_LARGEST_GROUP + c] = largest;
+    }
+    features[FEATURE_NEAR_EXPLODE] = nearExplode;
+    features[FEATURE_CONNECTIONS] = connections;
+}
+
+const char* BlocslotFeatureName(int feature)
+{
+    static char names[NUM_BOARD_FEATURES][16];
+    if (feature < 0 || feature >= NUM_BOARD_FEATURES)
+        return "";
+
+    if (!names[0][0])
+    {
+        for (int x=0; x<MAX_GAME_WIDTH; x++)
+            sprintf(names[FEATURE_HEIGHT + x], "height%d", x);
+        strcpy(names[FEATURE_HOLES], "holes");
+        strcpy(names[FEATURE_OVERHANGS], "overhangs");
+        for (int c=0; c<MAX_NUM_COLOURS; c++)
+            sprintf(names[FEATURE_LARGEST_GROUP + c], "largest%d", c+1);
+        strcpy(names[FEATURE_NEAR_EXPLODE], "near_explode");
+        strcpy(names[FEATURE_CONNECTIONS], "connections");
+    }
+    return names[feature];
+}
+
+template <class Size>
+static void ComputeFeatures(Size size, const uint8_t* boards, int explodeThreshold, int numBoards, int32_t* features)
+{
+    for (int i=0; i<numBoards; i++)
+    {
+        PackedBoard packed;
+        Pack(size, boards + i*size.Cells(), packed);
+        BoardFeatures(size, packed, explodeThreshold, features + i*NUM_BOARD_FEATURES);
+    }
+}
+
+void BlocslotComputeFeatures(const uint8_t* boards, int width, int height, int explodeThreshold, int numBoards, int32_t* features)
+{
+    // Boards of the default size are done by code compiled for it
+    if (width == DEFAULT_GAME_WIDTH && height == DEFAULT_GAME_HEIGHT)
+        ComputeFeatures(DefaultBoardSize(width, height), boards, explodeThreshold, numBoards, features);
+    else
+        ComputeFeatures(RuntimeBoardSize(width, height), boards, explodeThreshold, numBoards, features);
+}
+
+//
+// Writer ////////////////////////////////////////////////////////////////////////
+//
+
+struct BlocslotFeatureWriter
+{
+    FILE* file;
+    int numRows;                // Rows in the current block
+    int totalRows;
+    bool failed;
+    int32_t columns[NUM_BOARD_FEATURES][FEATURE_BLOCK_ROWS];
+};
+
+static void WriteBlock(BlocslotFeatureWriter* writer)
+{
+    if (!writer->numRows)
+        return;
+
+    uint32_t numRows = writer->numRows;
+    if (fwrite(&numRows, sizeof(numRows), 1, writer->file) != 1)
+        writer->failed = true;
+    for (int f=0; f<NUM_BOARD_FEATURES; f++)
+        if (fwrite(writer->columns[f], sizeof(int32_t), numRows, writer->file) != numRows)
+            writer->failed = true;
+
+    writer->totalRows += writer->numRows;
+    writer->numRows = 0;
+}
+
+BlocslotFeatureWriter* BlocslotFeatureWriterOpen(const char* filename, int explodeThreshold)
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+        return NULL;
+
+    BlocslotFeatureWriter* writer = (BlocslotFeatureWriter*)malloc(sizeof(BlocslotFeatureWriter));
+    if (!writer)
+    {
+        fclose(file);
+        return NULL;
+    }
+    writer->file = file;
+    writer->numRows = 0;
+    writer->totalRows = 0;
+    writer->failed = false;
+
+    uint32_t header[4] = { FEATURE_FILE_MAGIC, FEATURE_FILE_VERSION, NUM_BOARD_FEATURES, (uint32_t)explodeThreshold };
+    if (fwrite(header, sizeof(header), 1, file) != 1)
+        writer->failed = true;
+    for (int f=0; f<NUM_BOARD_FEATURES; f++)
+    {
+        char name[16] = {0};
+        strncpy(name, BlocslotFeatureName(f), sizeof(name) - 1);
+        if (fwrite(name, sizeof(name), 1, file) != 1)
+            writer->failed = true;
+    }
+    return writer;
+}
+
+void BlocslotFeatureWriterAppend(BlocslotFeatureWriter* writer, const int32_t* features, int numRows)
+{
+    for (int i=0; i<numRows; i++)
+    {
+        // Transpose into the block's columns
+        const int32_t* row = features + i*NUM_BOARD_FEATURES;
+        for (int f=0; f<NUM_BOARD_FEATURES; f++)
+            writer->columns[f][writer->numRows] = row[f];
+
+        if (++writer->numRows == FEATURE_BLOCK_ROWS)
+            WriteBlock(writer);
+    }
+}
+
+int BlocslotFeatureWriterClose(BlocslotFeatureWriter* writer)
+{
+    WriteBlock(writer);
+    if (fclose(writer->file))
+        writer->failed = true;
+
+    int result = writer->failed ? -1 : writer->totalRows;
+    free(writer);
+    return result;
+}
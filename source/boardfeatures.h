@@ -0,0 +1,79 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _BOARDFEATURES_H
+#define _BOARDFEATURES_H
+
+#include "gamerules.h"
+
+// Features of boards, for AI players and offline training.
+// Boards are in the form the batch environment returns them (see batchenv.h): width * height tile colours, row by row
+// from the top. Each board is packed into bitmasks, one per row for each colour (8 tiles at a time), and the
+// features are counted from those a row at a time rather than tile by tile. Groups are found by merging the runs of
+// tiles in each row with the runs they touch in the row above.
+//
+// This is a host library and doesn't use the Marmalade SDK. It builds alongside batchenv.cpp:
+//   c++ -O2 -std=c++11 -shared -fPIC -Isource source/batchenv.cpp source/boardfeatures.cpp source/gameparams.cpp -o libblocslotenv.so -lpthread
+
+// Groups this close to the explode threshold (but below it) are counted as near to exploding
+#define NEAR_EXPLODE_MARGIN 4
+
+// Columns of the feature matrix
+enum BoardFeature
+{
+    FEATURE_HEIGHT,                                             // Height of each column (0 beyond the board's width)
+    FEATURE_HOLES = FEATURE_HEIGHT + MAX_GAME_WIDTH,            // Empty cells with a tile somewhere above them
+    FEATURE_OVERHANGS,                                          // Empty cells with a tile directly above them
+    FEATURE_LARGEST_GROUP,                                      // Size of the largest group of each colour
+    FEATURE_NEAR_EXPLODE = FEATURE_LARGEST_GROUP + MAX_NUM_COLOURS,   // Number of groups near to exploding
+    FEATURE_CONNECTIONS,                                        // Number of pairs of adjacent tiles of the same colour
+
+    NUM_BOARD_FEATURES
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Name of a column of the feature matrix, e.g. "height3"
+const char* BlocslotFeatureName(int feature);
+
+// Compute the features of 'numBoards' boards of the given size, played with groups of 'explodeThreshold' tiles
+// exploding (GameParams::explodeThreshold). 'features' receives NUM_BOARD_FEATURES values per board, board by board
+void BlocslotComputeFeatures(const uint8_t* boards, int width, int height, int explodeThreshold, int numBoards, int32_t* features);
+
+// Writes feature matrices to a file column by column.
+// The file starts with a header (FEATURE_FILE_MAGIC, FEATURE_FILE_VERSION, NUM_BOARD_FEATURES, the explode threshold
+// the features were computed with, and then a 16 byte name for each column). Rows are then written in blocks of up to FEATURE_BLOCK_ROWS: the number of rows in the block,
+// followed by each column's values in turn. All values are 32 bit little endian
+#define FEATURE_FILE_MAGIC      0x54464342      // "BCFT"
+#define FEATURE_FILE_VERSION    3
+#define FEATURE_BLOCK_ROWS      4096
+
+typedef struct BlocslotFeatureWriter BlocslotFeatureWriter;
+
+// 'explodeThreshold' is the one the features are computed with, recorded in the header.
+// Returns NULL if the file couldn't be created
+BlocslotFeatureWriter* BlocslotFeatureWriterOpen(const char* filename, int explodeThreshold);
+
+// Append rows of a feature matrix, as filled in by BlocslotComputeFeatures
+void BlocslotFeatureWriterAppend(BlocslotFeatureWriter* writer, const int32_t* features, int numRows);
+
+// Write any rows still buffered and close the file. Returns the total number of rows written, or -1 if writing failed
+int BlocslotFeatureWriterClose(BlocslotFeatureWriter* writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !_BOARDFEATURES_H */
@@ -0,0 +1,210 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _BOARDRULES_H
+#define _BOARDRULES_H
+
+#include "gamerules.h"
+
+#include <string.h>
+
+// The board algorithms: connecting tiles, finding groups and making unsupported groups fall. The game's Grid and the
+// batch environment (see batchenv.h) both use these, so they can't play by different rules.
+// This doesn't use the Marmalade SDK, so it can be built into host tools.
+//
+// Cells are numbered row by row from the top left. The algorithms work on any 'Board' class which provides:
+//   int Width() const, int Height() const
+//   int Colour(int i) const                 Colour of the tile in cell i (0 if the cell is empty)
+//   uint32_t Connections(int i) const       Its ConnectFlags
+//   void SetConnections(int i, uint32_t c)
+//   int GroupId(int i) const                Group it's in (-1 until the groups have been found)
+//   void SetGroupId(int i, int id)
+//   void MoveDown(int i)                    Move the tile (and its group id) into the empty cell below, leaving cell i
+//                                           empty with a group id of -1
+
+// Connect every tile to the neighbouring tiles of the same colour.
+// Returns the number of connections which weren't there before
+template <class Board>
+inline int BoardUpdateConnections(Board& board)
+{
+    int width = board.Width();
+    int height = board.Height();
+
+    int count = 0;
+    for (int y=0; y<height; y++)
+    {
+        for (int x=0; x<width; x++)
+        {
+            int i = y*width + x;
+            int col = board.Colour(i);
+            if (!col)
+                continue;
+
+            uint32_t connect = 0;
+            if (x>0 && board.Colour(i-1) == col)
+                connect |= CONNECT_LEFT;
+            if (x<width-1 && board.Colour(i+1) == col)
+                connect |= CONNECT_RIGHT;
+            if (y>0 && board.Colour(i-width) == col)
+                connect |= CONNECT_UP;
+            if (y<height-1 && board.Colour(i+width) == col)
+                connect |= CONNECT_DOWN;
+
+            for (uint32_t extra = connect & ~board.Connections(i); extra; extra >>= 1)
+                count += extra & 1;
+            board.SetConnections(i, connect);
+        }
+    }
+
+    // Each connection is counted from both ends
+    return count / 2;
+}
+
+// Find the groups of adjacent tiles of the same colour, setting every tile's group id. Groups are numbered in the order
+// their first tiles are reached going down each column from the left.
+// Each group is found breadth first, and the queue of tiles that leaves behind is the list of the group's tiles: group
+// id's tiles are 'tiles[starts[id]]' onwards, and there are 'sizes[id]' of them. Each array needs an entry per cell.
+// Returns the number of groups
+template <class Board>
+inline int BoardCreateGroups(Board& board, int* sizes, int* starts, int* tiles)
+{
+    int width = board.Width();
+    int height = board.Height();
+    int numCells = width*height;
+
+    for (int i=0; i<numCells; i++)
+        board.SetGroupId(i, -1);
+
+    int numGroups = 0;
+    int numTiles = 0;
+    for (int x=0; x<width; x++)
+    {
+        for (int y=0; y<height; y++)
+        {
+            int start = y*width + x;
+            int col = board.Colour(start);
+            if (!col || board.GroupId(start) != -1)
+                continue;
+
+            int id = numGroups++;
+            starts[id] = numTiles;
+            board.SetGroupId(start, id);
+            tiles[numTiles++] = start;
+            for (int next=starts[id]; next<numTiles; next++)
+            {
+                int i = tiles[next];
+                int tx = i % width;
+                int ty = i / width;
+
+                int neighbours[4] = { tx>0 ? i-1 : -1, tx<width-1 ? i+1 : -1, ty>0 ? i-width : -1, ty<height-1 ? i+width : -1 };
+                for (int n=0; n<4; n++)
+                {
+                    int j = neighbours[n];
+                    if (j >= 0 && board.GroupId(j) == -1 && board.Colour(j) == col)
+                    {
+                        board.SetGroupId(j, id);
+                        tiles[numTiles++] = j;
+                    }
+                }
+            }
+            sizes[id] = numTiles - starts[id];
+        }
+    }
+    return numGroups;
+}
+
+// Returns the first group after 'after' with at least 'threshold' tiles, or -1 if there isn't one. This is the order
+// the groups explode in
+inline int BoardNextExplosion(const int* sizes, int numGroups, int threshold, int after)
+{
+    for (int id=after+1; id<numGroups; id++)
+        if (sizes[id] >= threshold)
+            return id;
+    return -1;
+}
+
+// Number of ints of scratch space BoardMakeFall needs
+inline int BoardFallScratchSize(int numCells, int numGroups)
+{
+    return numCells + numGroups*3 + 1;
+}
+
+// Move every unsupported group down one row, using the group ids from BoardCreateGroups (which stay correct as the
+// groups fall). Returns true if anything moved.
+// The groups resting directly on each group are listed first, and support is then spread up from the groups on the
+// bottom row, so the time taken doesn't depend on how the groups are stacked
+template <class Board>
+inline bool BoardMakeFall(Board& board, int numGroups, int* scratch)
+{
+    int width = board.Width();
+    int numCells = width*board.Height();
+    int numAbove = numCells - width;
+    if (numGroups <= 0)
+        return false;
+
+    int* restStarts = scratch;
+    int* supported = restStarts + numGroups + 1;
+    int* queue = supported + numGroups;
+    int* rests = queue + numGroups;
+
+    // Count the groups resting on each group, and then list them. Each group's list is filled in from the end, which
+    // leaves restStarts[id] at the start of group id's list
+    memset(restStarts, 0, (numGroups + 1)*sizeof(int));
+    for (int i=0; i<numAbove; i++)
+        if (board.Colour(i) && board.Colour(i+width) && board.GroupId(i) != board.GroupId(i+width))
+            restStarts[board.GroupId(i+width)]++;
+    for (int id=1; id<=numGroups; id++)
+        restStarts[id] += restStarts[id-1];
+    for (int i=0; i<numAbove; i++)
+        if (board.Colour(i) && board.Colour(i+width) && board.GroupId(i) != board.GroupId(i+width))
+            rests[--restStarts[board.GroupId(i+width)]] = board.GroupId(i);
+
+    // Groups on the bottom row are supported, and so is every group resting on a supported group
+    memset(supported, 0, numGroups*sizeof(int));
+    int numQueued = 0;
+    for (int i=numAbove; i<numCells; i++)
+    {
+        int id = board.GroupId(i);
+        if (board.Colour(i) && !supported[id])
+        {
+            supported[id] = 1;
+            queue[numQueued++] = id;
+        }
+    }
+    for (int next=0; next<numQueued; next++)
+    {
+        int id = queue[next];
+        for (int r=restStarts[id]; r<restStarts[id+1]; r++)
+        {
+            if (!supported[rests[r]])
+            {
+                supported[rests[r]] = 1;
+                queue[numQueued++] = rests[r];
+            }
+        }
+    }
+
+    // Move the unsupported tiles from the bottom up, so each one moves into a cell which has already been emptied
+    bool falling = false;
+    for (int i=numAbove-1; i>=0; i--)
+    {
+        if (board.Colour(i) && !supported[board.GroupId(i)])
+        {
+            board.MoveDown(i);
+            falling = true;
+        }
+    }
+    return falling;
+}
+
+#endif /* !_BOARDRULES_H */
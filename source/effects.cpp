@@ -13,20 +13,131 @@
 
 #include "effects.h"
 #include "rendering.h"
+#include "trace.h"
 
 #include "Iw2D.h"
+#include "s3eConfig.h"
+
+#include <stdio.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 EffectManager * g_EffectsManager = NULL;
 
+// A score is added to the last score text if that's younger than this (in milliseconds)
+#define SCORE_TEXT_MERGE_MS 500
+
+static const EffectQualitySettings s_QualitySettings[NUM_EFFECT_QUALITIES] =
+{
+    { 1, 500, 0, true },    // EFFECT_QUALITY_LOW
+    { 1, 250, 2, false },   // EFFECT_QUALITY_MEDIUM
+    { 2, 0,   1, false },   // EFFECT_QUALITY_HIGH
+};
+
+static const char* s_QualityNames[NUM_EFFECT_QUALITIES] =
+{
+    "low",
+    "medium",
+    "high",
+};
+
+const char* EffectQualityName(int quality)
+{
+    return s_QualityNames[quality];
+}
+
+//
+// EffectGovernor class ////////////////////////////////////////////////////////////////////////
+//
+
+EffectGovernor::EffectGovernor()
+{
+    int setting = -1;
+    s3eConfigGetInt("Blocslot", "EffectQuality", &setting);
+    automatic = setting < 0 || setting >= NUM_EFFECT_QUALITIES;
+    quality = automatic ? EFFECT_QUALITY_HIGH : setting;
+    smoothedUs = 0;
+    framesSinceChange = 0;
+    framesWithHeadroom = 0;
+}
+
+void EffectGovernor::SetQuality(int newQuality)
+{
+    quality = newQuality;
+    framesSinceChange = 0;
+    framesWithHeadroom = 0;
+    TraceCounter(TRACE_EFFECT_QUALITY, quality);
+}
+
+void EffectGovernor::Update(int frameUs, int budgetUs)
+{
+    smoothedUs += (frameUs - smoothedUs) / 4;
+    framesSinceChange++;
+    if (!automatic)
+        return;
+
+    if (smoothedUs * 100 > budgetUs * EFFECT_QUALITY_LOWER_PERCENT)
+    {
+        framesWithHeadroom = 0;
+        if (quality > EFFECT_QUALITY_LOW && framesSinceChange >= EFFECT_QUALITY_LOWER_FRAMES)
+            SetQuality(quality - 1);
+    }
+    else if (smoothedUs * 100 < budgetUs * EFFECT_QUALITY_RAISE_PERCENT)
+    {
+        if (++framesWithHeadroom >= EFFECT_QUALITY_RAISE_FRAMES && quality < EFFECT_QUALITY_HIGH)
+            SetQuality(quality + 1);
+    }
+    else
+        framesWithHeadroom = 0;
+}
+
+//
+// Effect class ////////////////////////////////////////////////////////////////////////
+//
+
+// Slots effects are allocated from (uint64 keeps them 8 byte aligned)
+static uint64 s_EffectSlots[MAX_EFFECTS][EFFECT_SLOT_SIZE / sizeof(uint64)];
+static bool s_EffectSlotUsed[MAX_EFFECTS];
+
+void* Effect::operator new(size_t size)
+{
+    // Subclasses are checked with EFFECT_CHECK_SLOT_SIZE, so this only fires for one which has been left unchecked
+    IwAssertMsg(APP, size <= EFFECT_SLOT_SIZE, ("Effect is too large for the pool (%d bytes)", (int)size));
+
+    for (int i=0; i<MAX_EFFECTS; i++)
+    {
+        if (!s_EffectSlotUsed[i])
+        {
+            s_EffectSlotUsed[i] = true;
+            return s_EffectSlots[i];
+        }
+    }
+
+    // The pool has run out
+    return ::operator new(size);
+}
+
+void Effect::operator delete(void* p)
+{
+    char* slots = (char*)s_EffectSlots;
+    if ((char*)p >= slots && (char*)p < slots + sizeof(s_EffectSlots))
+        s_EffectSlotUsed[((char*)p - slots) / EFFECT_SLOT_SIZE] = false;
+    else
+        ::operator delete(p);
+}
+
 //
 // FloatText class ////////////////////////////////////////////////////////////////////////
 //
 
-FloatText::FloatText(CIwVec2 const & startPos, const char * string)
+FloatText::FloatText(CIwVec2 const & startPos, const char * string, int _points)
 {
     timer = 0;
     pos = startPos;
-    text = string;
+    points = _points;
+    text.Set(string);
 }
 
 bool FloatText::Update(int timeDeltaMs)
@@ -42,44 +153,113 @@ bool FloatText::Update(int timeDeltaMs)
 void FloatText::Render()
 {
     // Convert position to pixels
-    // Set the rectangle for font rendering to 400 pixels square (arbitrary) centered on our position
-    Iw2DDrawString(text.c_str(),
-        CIwSVec2((int16)IW_FIXED_MUL(pos.x, g_TileSize)-200,(int16)IW_FIXED_MUL(pos.y, g_TileSize)-200),
-        CIwSVec2(400,400),
+    // The text is centered within a 400 pixel square (arbitrary) centered on our position
+    RenderDrawText(text,
+        IW_FIXED_MUL(pos.x, g_TileSize)-200, IW_FIXED_MUL(pos.y, g_TileSize)-200,
+        400, 400,
         IW_2D_FONT_ALIGN_CENTRE, IW_2D_FONT_ALIGN_CENTRE);
 }
 
 
 //
-// ExplosionFragment class ////////////////////////////////////////////////////////////////////////
+// ExplosionFragments class ////////////////////////////////////////////////////////////////////////
 //
 
-ExplosionFragment::ExplosionFragment(CIwVec2 const & startPos, CIwVec2 const & startVel, int _colour)
+void ExplosionFragments::Add(CIwVec2 const & startPos, CIwVec2 const & startVel, int startAge)
 {
-    colour = _colour;
-    timer = random() % 200;
-    pos = startPos;
-    vel = startVel;
+    // Drop new fragments if there are already too many on screen
+    if (count >= MAX_EXPLOSION_FRAGMENTS)
+        return;
 
-    vel.y -= 100000;
+    posX[count] = startPos.x;
+    posY[count] = startPos.y;
+    velX[count] = startVel.x;
+    velY[count] = startVel.y - 100000;
+    timer[count] = startAge + random() % 200;
+    count++;
 }
-bool ExplosionFragment::Update(int timeDeltaMs)
+
+void ExplosionFragments::Update(int timeDeltaMs)
 {
-    timer += timeDeltaMs;
+    // Integrate all fragments in one pass. Position is moved by the velocity before gravity is applied,
+    // and IW_FIXED_MUL's rounding is matched by the rounding shift in the NEON path.
+    // The arrays are sized to a multiple of 4, so the vector loop may safely run past 'count'.
+#if defined(__ARM_NEON__)
+    int32x4_t dt = vdupq_n_s32(timeDeltaMs);
+    int32x4_t gravity = vdupq_n_s32(timeDeltaMs * 300);
+    for (int i=0; i<count; i+=4)
+    {
+        int32x4_t vx = vld1q_s32(velX + i);
+        int32x4_t vy = vld1q_s32(velY + i);
+        vst1q_s32(posX + i, vaddq_s32(vld1q_s32(posX + i), vrshrq_n_s32(vmulq_s32(vx, dt), IW_GEOM_POINT)));
+        vst1q_s32(posY + i, vaddq_s32(vld1q_s32(posY + i), vrshrq_n_s32(vmulq_s32(vy, dt), IW_GEOM_POINT)));
+        vst1q_s32(velY + i, vaddq_s32(vy, gravity));
+        vst1q_s32(timer + i, vaddq_s32(vld1q_s32(timer + i), dt));
+    }
+#else
+    int gravity = timeDeltaMs * 300;
+    for (int i=0; i<count; i++)
+    {
+        posX[i] += IW_FIXED_MUL(velX[i], timeDeltaMs);
+        posY[i] += IW_FIXED_MUL(velY[i], timeDeltaMs);
+        velY[i] += gravity;
+        timer[i] += timeDeltaMs;
+    }
+#endif
 
-    // Move under gravity
-    pos += vel * timeDeltaMs;
+    // The effect disappears after about 1 second.
+    // Remove expired fragments by moving the last one into their slot (the draw order doesn't matter with additive blending)
+    for (int i=0; i<count; )
+    {
+        if (timer[i] >= 1000)
+        {
+            count--;
+            posX[i] = posX[count];
+            posY[i] = posY[count];
+            velX[i] = velX[count];
+            velY[i] = velY[count];
+            timer[i] = timer[count];
+        }
+        else
+            i++;
+    }
+}
 
-    vel.y += timeDeltaMs * 300;
+void ExplosionFragments::Project(int tileSize)
+{
+    // Fragments shrink from twice the tile size down to nothing over their lifetime.
+    // The division by the lifetime is folded into a 16.16 fixed point scale so the loop only needs multiplies and shifts.
+    int32 sizeScale = (tileSize * 2 << 16) / 1000;
 
-    // The effect disappears after about 1 second
-    return timer<1000;
+#if defined(__ARM_NEON__)
+    int32x4_t scale = vdupq_n_s32(sizeScale);
+    int32x4_t ts = vdupq_n_s32(tileSize);
+    int32x4_t lifetime = vdupq_n_s32(1000);
+    for (int i=0; i<count; i+=4)
+    {
+        int32x4_t size = vshrq_n_s32(vmulq_s32(vsubq_s32(lifetime, vld1q_s32(timer + i)), scale), 16);
+        int32x4_t half = vshrq_n_s32(size, 1);
+        int32x4_t x = vrshrq_n_s32(vmulq_s32(vld1q_s32(posX + i), ts), IW_GEOM_POINT);
+        int32x4_t y = vrshrq_n_s32(vmulq_s32(vld1q_s32(posY + i), ts), IW_GEOM_POINT);
+        vst1q_s32(quadX + i, vsubq_s32(x, half));
+        vst1q_s32(quadY + i, vsubq_s32(y, half));
+        vst1q_s32(quadSize + i, size);
+    }
+#else
+    for (int i=0; i<count; i++)
+    {
+        int32 size = ((1000 - timer[i]) * sizeScale) >> 16;
+        quadX[i] = IW_FIXED_MUL(posX[i], tileSize) - size/2;
+        quadY[i] = IW_FIXED_MUL(posY[i], tileSize) - size/2;
+        quadSize[i] = size;
+    }
+#endif
 }
-void ExplosionFragment::Render()
+
+void ExplosionFragments::Render()
 {
-    int size = g_TileSize * 2;
-    size = size * (1000-timer) / 1000;
-    DrawSpriteCentered(starImage, IW_FIXED_MUL(pos.x, g_TileSize), IW_FIXED_MUL(pos.y, g_TileSize), size);
+    for (int i=0; i<count; i++)
+        RenderDrawImage(IMAGE_STAR, quadX[i], quadY[i], quadSize[i], quadSize[i]);
 }
 
 
@@ -92,35 +272,93 @@ EffectManager::~EffectManager()
     Clear();
 }
 
+void EffectManager::Add(Effect* e)
+{
+    // If there are too many effects already, the new one isn't shown
+    if (numEffects == MAX_EFFECTS)
+    {
+        delete e;
+        return;
+    }
+
+    effects[numEffects++] = e;
+}
+
+void EffectManager::AddTileFragments(CIwVec2 const & pos, CIwVec2 const & dir)
+{
+    // With only one fragment, the faster one is kept so the explosion still spreads as far
+    EffectQualitySettings const & settings = GetQualitySettings();
+    if (settings.fragmentsPerTile > 1)
+        fragments.Add(pos, dir * IW_FIXED(27), settings.fragmentStartAge);
+    fragments.Add(pos, dir * IW_FIXED(60), settings.fragmentStartAge);
+}
+
+void EffectManager::AddScoreText(CIwVec2 const & pos, const char * string, int points)
+{
+    if (lastScoreText && GetQualitySettings().mergeScoreText && lastScoreText->timer < SCORE_TEXT_MERGE_MS)
+    {
+        // Show the total, and keep it alive for as long as the scores keep coming
+        char total[MAX_SCORE_TEXT];
+        lastScoreText->points += points;
+        snprintf(total, sizeof(total), "%d", lastScoreText->points);
+        lastScoreText->text.Set(total);
+        lastScoreText->timer = 0;
+        return;
+    }
+
+    FloatText* text = new FloatText(pos, string, points);
+    lastScoreText = numEffects < MAX_EFFECTS ? text : NULL;
+    Add(text);
+}
+
+EffectQualitySettings const & EffectManager::GetQualitySettings() const
+{
+    return s_QualitySettings[governor.quality];
+}
+
 void EffectManager::Clear()
 {
-    for (uint32 i=0; i<effects.size(); i++)
+    for (int i=0; i<numEffects; i++)
         delete effects[i];
-    effects.clear();
+    numEffects = 0;
+    lastScoreText = NULL;
+
+    fragments.count = 0;
 }
 
 void EffectManager::Update(int timeDeltaMs)
 {
-    for (uint32 i=0; i<effects.size(); )
+    fragments.Update(timeDeltaMs);
+
+    for (int i=0; i<numEffects; )
     {
         Effect* e = effects[i];
         if (!effects[i]->Update(timeDeltaMs))
         {
-            // Note: this is quite inefficient if many objects are removed at the same time
-            effects.erase(i);
+            // Keep the remaining effects in order, so they're still drawn in the order they were added
+            numEffects--;
+            memmove(effects + i, effects + i + 1, (numEffects - i) * sizeof(Effect*));
+            if (e == lastScoreText)
+                lastScoreText = NULL;
             delete e;
         }
         else
             i++;
     }
+
+    TraceCounter(TRACE_PARTICLES, fragments.count + numEffects);
 }
 
 void EffectManager::Render()
 {
-    Iw2DSetColour(0xff808080);
-    Iw2DSetAlphaMode(IW_2D_ALPHA_ADD);
-    for (uint32 i=0; i<effects.size(); i++)
+    RenderSetColour(0xff808080);
+    RenderSetAlphaMode(RENDER_ALPHA_ADD);
+
+    fragments.Project(g_TileSize);
+    fragments.Render();
+
+    for (int i=0; i<numEffects; i++)
         effects[i]->Render();
-    Iw2DSetAlphaMode(IW_2D_ALPHA_NONE);
-    Iw2DSetColour(0xffffffff);
+    RenderSetAlphaMode(RENDER_ALPHA_NONE);
+    RenderSetColour(0xffffffff);
 }
@@ -14,58 +14,160 @@
 #ifndef _EFFECTS_H
 #define _EFFECTS_H
 
-#include "IwArray.h"
 #include "IwGeom.h"
-#include "IwString.h"
+#include "rendertext.h"
 
 // Note: the position of effects is stored as a fixed point position in the playing area.
 // So IW_GEOM_ONE is the size of a tile.
 // This allows the positions to remain consistant when the screen is rotated
 
+// Maximum number of effects (other than explosion fragments) alive at once
+#define MAX_EFFECTS 32
+
+// Level of detail of the effects, which is lowered while frames are taking too long (see EffectGovernor)
+enum EffectQuality
+{
+    EFFECT_QUALITY_LOW,
+    EFFECT_QUALITY_MEDIUM,
+    EFFECT_QUALITY_HIGH,
+    NUM_EFFECT_QUALITIES,
+};
+
+// What each EffectQuality draws
+struct EffectQualitySettings
+{
+    int fragmentsPerTile;   // Explosion fragments created for each exploding tile (1 or 2)
+    int fragmentStartAge;   // Fragments start this many milliseconds into their life, so they're smaller and gone sooner
+    int rippleSpacing;      // Tiles between the nodes of the ripple (0 for no ripple)
+    bool mergeScoreText;    // Scores which follow each other quickly are added to one floating text
+};
+
+const char* EffectQualityName(int quality);
+
+// Frame time, as a percentage of the frame's budget, above which the quality is lowered and below which it's raised
+#define EFFECT_QUALITY_LOWER_PERCENT    85
+#define EFFECT_QUALITY_RAISE_PERCENT    60
+
+// Frames after a change before the quality is lowered again (so the last change has time to show in the frame time), and
+// frames the frame time has to stay below EFFECT_QUALITY_RAISE_PERCENT before the quality is raised
+#define EFFECT_QUALITY_LOWER_FRAMES     10
+#define EFFECT_QUALITY_RAISE_FRAMES     90
+
+// Chooses the effect quality from the headroom left in each frame.
+// The frame time is smoothed so a single slow frame doesn't change anything. The quality is lowered a level as soon as
+// the smoothed time goes over EFFECT_QUALITY_LOWER_PERCENT of the budget, but only raised again once there has been
+// plenty of headroom for a while, so it doesn't flicker between levels when the frame time is close to a threshold.
+// EffectQuality in app.icf can fix the quality instead.
+struct EffectGovernor
+{
+    int quality;
+    bool automatic;         // False if the quality has been fixed by the settings
+    int smoothedUs;         // Moving average of the frame time
+    int framesSinceChange;
+    int framesWithHeadroom;
+
+    EffectGovernor();
+
+    // Called once per frame with the time the frame's work took and the time it had, in microseconds
+    void Update(int frameUs, int budgetUs);
+    void SetQuality(int newQuality);
+};
+
+// Size of the slots effects are allocated from. Every Effect subclass must fit, which EFFECT_CHECK_SLOT_SIZE checks
+// when it's compiled
+#define EFFECT_SLOT_SIZE 96
+
+// Put after each Effect subclass, so that one which has grown too big for a slot doesn't compile
+#define EFFECT_CHECK_SLOT_SIZE(type) typedef char type##FitsEffectSlot[sizeof(type) <= EFFECT_SLOT_SIZE ? 1 : -1]
+
 // Base class for graphical effects
+// Effects are allocated from a fixed pool of MAX_EFFECTS slots rather than the heap. If the pool runs out, the heap is
+// used instead.
 struct Effect
 {
     virtual bool Update(int timeDeltaMs) = 0;
     virtual void Render() = 0;
     virtual ~Effect() {}
+
+    static void* operator new(size_t size);
+    static void operator delete(void* p);
 };
 
-// A star-shaped particle, used when tiles explode
-struct ExplosionFragment : public Effect
+// Maximum number of explosion fragments alive at once.
+// Each exploding tile creates two fragments, so this allows for several overlapping full-sized explosions.
+// Must be a multiple of 4 (the fragment kernels process 4 fragments at a time).
+#define MAX_EXPLOSION_FRAGMENTS 1024
+
+// Star-shaped particles, used when tiles explode.
+// The fragments are stored as a structure of arrays so that a whole batch can be integrated and projected in one pass,
+// rather than updating and rendering one object at a time.
+struct ExplosionFragments
 {
-    CIwVec2 pos;
-    CIwVec2 vel;
-    int timer;
-    int colour;
+    int count;
 
-    ExplosionFragment(CIwVec2 const & startPos, CIwVec2 const & startVel, int _colour);
-    bool Update(int timeDeltaMs);
+    // Simulation state (fixed point playing area units)
+    int32 posX[MAX_EXPLOSION_FRAGMENTS];
+    int32 posY[MAX_EXPLOSION_FRAGMENTS];
+    int32 velX[MAX_EXPLOSION_FRAGMENTS];
+    int32 velY[MAX_EXPLOSION_FRAGMENTS];
+    int32 timer[MAX_EXPLOSION_FRAGMENTS];
+
+    // Screen space quads (top-left corner and size in pixels) written by Project()
+    int32 quadX[MAX_EXPLOSION_FRAGMENTS];
+    int32 quadY[MAX_EXPLOSION_FRAGMENTS];
+    int32 quadSize[MAX_EXPLOSION_FRAGMENTS];
+
+    ExplosionFragments() : count(0) {}
+    void Add(CIwVec2 const & startPos, CIwVec2 const & startVel, int startAge);
+    void Update(int timeDeltaMs);
+    void Project(int tileSize);
     void Render();
 };
 
+// Longest score popup, e.g. "1200x64" (enough for two ints and the 'x')
+#define MAX_SCORE_TEXT 24
+
 // Floating text - drifts upwards, then disappears. Used to show the player how much score they're getting.
 struct FloatText : public Effect
 {
     CIwVec2 pos;
     int timer;
-    CIwStringL text;
+    int points;     // Points the text shows, for adding later scores to it
+    RenderTextSized<MAX_SCORE_TEXT> text;
 
-    FloatText(CIwVec2 const & startPos, const char * string);
+    FloatText(CIwVec2 const & startPos, const char * string, int _points);
     bool Update(int timeDeltaMs);
     void Render();
 };
+EFFECT_CHECK_SLOT_SIZE(FloatText);
 
 // Manager for graphical effects.
 // All new instances of Effect should be added to a manager, which is then resposible for updating/rendering/deleting them.
 struct EffectManager
 {
-    CIwArray<Effect*> effects;
+    Effect* effects[MAX_EFFECTS];
+    int numEffects;
+    ExplosionFragments fragments;
+    FloatText* lastScoreText;   // Most recent score text, while it's still alive
+    EffectGovernor governor;
 
+    EffectManager() : numEffects(0), lastScoreText(NULL) {}
     ~EffectManager();
-    void Add(Effect* e) { effects.append(e); }
+    void Add(Effect* e);
+
+    // Add the fragments for one exploding tile, flying out from 'pos' in direction 'dir' (a unit vector)
+    void AddTileFragments(CIwVec2 const & pos, CIwVec2 const & dir);
+
+    // Show the points scored at 'pos'. When the quality asks for it, scores which quickly follow the last one are added
+    // to its text instead
+    void AddScoreText(CIwVec2 const & pos, const char * string, int points);
+
+    void UpdateQuality(int frameUs, int budgetUs) { governor.Update(frameUs, budgetUs); }
+    EffectQualitySettings const & GetQualitySettings() const;
     void Clear();
     void Update(int timeDeltaMs);
     void Render();
+    bool IsActive() const { return numEffects != 0 || fragments.count != 0; }
 };
 
 extern EffectManager * g_EffectsManager;
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "framescheduler.h"
+#include "s3eConfig.h"
+#include "s3eDevice.h"
+#include "s3eTimer.h"
+#include "s3eDebug.h"
+
+// Interval between reports of missed deadlines
+#define FRAME_REPORT_INTERVAL_MS 10000
+
+FrameScheduler::FrameScheduler()
+{
+    int targetFPS = 60;
+    int idleFPS = 15;
+    s3eConfigGetInt("Blocslot", "TargetFPS", &targetFPS);
+    s3eConfigGetInt("Blocslot", "IdleFPS", &idleFPS);
+
+    if (targetFPS < 1)
+        targetFPS = 1;
+    if (idleFPS < 1 || idleFPS > targetFPS)
+        idleFPS = targetFPS;
+
+    targetFrameMs = 1000 / targetFPS;
+    idleFrameMs = 1000 / idleFPS;
+
+    lastFrame = lastReport = s3eTimerGetMs();
+    missedDeadlines = 0;
+    numFrames = 0;
+}
+
+void FrameScheduler::WaitForNextFrame(bool animating)
+{
+    int64 deadline = lastFrame + (animating ? targetFrameMs : idleFrameMs);
+    int64 now = s3eTimerGetMs();
+
+    if (now > deadline)
+    {
+        // The frame overran. Always yield, so that events are still processed
+        missedDeadlines++;
+        s3eDeviceYield(0);
+        now = s3eTimerGetMs();
+
+        // Start the next frame now, rather than trying to catch up
+        deadline = now;
+    }
+    else
+    {
+        // Sleep until just before the deadline, then yield without sleeping for the remainder,
+        // since the sleep can overshoot by a millisecond or so
+        while (now < deadline)
+        {
+            int remaining = (int)(deadline - now);
+            s3eDeviceYield(remaining > 2 ? remaining - 2 : 0);
+            now = s3eTimerGetMs();
+        }
+    }
+
+    lastFrame = deadline;
+    numFrames++;
+
+    if (now - lastReport >= FRAME_REPORT_INTERVAL_MS)
+    {
+        if (missedDeadlines)
+            s3eDebugTracePrintf("Frame pacing: %d of %d frames started late", missedDeadlines, numFrames);
+
+        missedDeadlines = 0;
+        numFrames = 0;
+        lastReport = now;
+    }
+}
@@ -0,0 +1,43 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _FRAMESCHEDULER_H
+#define _FRAMESCHEDULER_H
+
+#include "s3eTypes.h"
+
+// Paces the main loop.
+// Frames start at a fixed rate (TargetFPS in app.icf), dropping to a lower rate (IdleFPS) on screens with little or no movement.
+// The time until the next frame is spent yielding to the OS rather than rendering, which saves battery and heat.
+class FrameScheduler
+{
+private:
+    int targetFrameMs;      // Time between frames while animating
+    int idleFrameMs;        // Time between frames while idle
+    int64 lastFrame;        // Time the current frame started
+    int missedDeadlines;    // Frames which started late, since the last report
+    int numFrames;          // Frames since the last report
+    int64 lastReport;
+
+public:
+    FrameScheduler();
+
+    // Wait until it's time to start the next frame. 'animating' is false if nothing has changed on screen since the last frame
+    // (apart from in response to input), so the idle rate can be used
+    void WaitForNextFrame(bool animating);
+
+    // Time each frame has while animating, in milliseconds
+    int GetFrameBudgetMs() const { return targetFrameMs; }
+};
+
+#endif /* !_FRAMESCHEDULER_H */
@@ -12,11 +12,19 @@
  */
 
 #include "game.h"
+#include "boardrules.h"
 #include "effects.h"
 #include "rendering.h"
 #include "localise.h"
+#include "profile.h"
+#include "trace.h"
+#include "allocstats.h"
+#include "recording.h"
 
 #include "Iw2D.h"
+#include "s3eConfig.h"
+#include "s3eDebug.h"
+#include "s3eFile.h"
 #include "s3eKeyboard.h"
 #include "s3ePointer.h"
 
@@ -24,40 +32,106 @@
 
 #include "SkillzSDK.h"
 
-// Level progression settings
-// Gravity is the number of milliseconds before the piece is automatically moved down one square
-// Colours per level is the number of different colours used. This shouldn't decrease, else the player might be left with pieces they can't get rid of.
-// piecesLevelBoundary is the cumulative number of pieces played to reach each level
-// Currently, the level 0 settings are never used (levels go 1,2,3,4,5,6,7,8,9)
-const int gravityPerLevel[10] = {400, 400, 290, 180, 300, 200, 120, 80,  60,  50,};
-const int coloursPerLevel[10] = {  5,   5,   5,   5,   6,   6,   6,   6,   6,   6,};
-const int piecesLevelBoundary[10] = {   0,   30,  60,  90,  120, 150, 180, 210, 250, -1,};
-
 GameMode g_GameMode = MODE_TITLE;
 
 int g_DrawTouchscreenButtons = 0;
 
+GameParams g_GameParams;
+
+// Draw a shadow of the active piece where it will land (GhostPiece setting)
+static int s_DrawGhostPiece = 0;
+
 CIwSVec2 g_RippleCentre;
 int32 g_RippleDuration = 0;
 
+// Coarse grid of ripple displacements covering the playing area.
+// This is rebuilt once per frame while a ripple is active, so the per-vertex post transform
+// only needs a bilinear lookup rather than a square root, normalise and sine.
+#define RIPPLE_FIELD_MAX_NODES 64
+
+struct RippleField
+{
+    int originX, originY;   // Screen position of the first node (in subpixels)
+    int cellShift;          // Log2 of the node spacing (in subpixels)
+    int numX, numY;         // Number of nodes across and down
+    int16 dx[RIPPLE_FIELD_MAX_NODES*RIPPLE_FIELD_MAX_NODES];
+    int16 dy[RIPPLE_FIELD_MAX_NODES*RIPPLE_FIELD_MAX_NODES];
+
+    void Build(CIwSVec2 const & centre, int x0, int y0, int w, int h, int spacing);
+};
+
+static RippleField s_RippleField;
+
+// Evaluate the ripple at nodes spaced roughly 'spacing' tiles apart over the specified screen area (in pixels)
+// 'centre' is the screen position of the centre of the ripple (in pixels)
+void RippleField::Build(CIwSVec2 const & centre, int x0, int y0, int w, int h, int spacing)
+{
+    //Get the centre of the ripple in subpixels (8 subpixels per pixel)
+    CIwSVec2 rippleCentre = centre << 3;
+
+    // Use a power of two node spacing so the lookup only needs shifts and masks
+    cellShift = 3;
+    while ((1 << cellShift) < g_TileSize*8*spacing ||
+        ((w*8) >> cellShift) + 2 > RIPPLE_FIELD_MAX_NODES ||
+        ((h*8) >> cellShift) + 2 > RIPPLE_FIELD_MAX_NODES)
+        cellShift++;
+
+    originX = x0 << 3;
+    originY = y0 << 3;
+    numX = ((w*8) >> cellShift) + 2;
+    numY = ((h*8) >> cellShift) + 2;
+
+    int16* outX = dx;
+    int16* outY = dy;
+    for (int ny=0; ny<numY; ny++)
+    {
+        for (int nx=0; nx<numX; nx++)
+        {
+            CIwSVec2 dirToCentre = CIwSVec2(originX + (nx << cellShift), originY + (ny << cellShift)) - rippleCentre;
+            int32 distToCentre = dirToCentre.GetLength() / g_TileSize;
+            int32 rippleHeight = distToCentre*20 + (g_RippleDuration)*7 + IW_GEOM_ONE/2;
+            *outX = *outY = 0;
+            if (distToCentre && rippleHeight >= 0)
+            {
+                dirToCentre.Normalise();
+                int ofs = IW_FIXED_MUL(IW_FIXED_MUL(g_TileSize*(4<<3), g_RippleDuration*2), IwGeomSin(rippleHeight));
+                CIwSVec2 d = dirToCentre * ofs;
+                *outX = d.x;
+                *outY = d.y;
+            }
+            outX++;
+            outY++;
+        }
+    }
+}
+
 //Iw2D supports an arbitrary post-transformation to be applied to all generated points/colours
+//This is only installed while the playing area is drawn, so the background and text are not affected
 void RippleFunc(CIwSVec2* v, CIwColour* c, int32 points)
 {
-    //Get the centre of the ripple in subpixels (8 subpixels per pixel)
-    //Apply the transform matrix to the centre, so it's in the correct place
-    CIwSVec2 rippleCentre = (CIwSVec2)(Iw2DGetTransformMatrix().TransformVec(g_RippleCentre) << 3);
+    RippleField const & f = s_RippleField;
+    int mask = (1 << f.cellShift) - 1;
+    int maxX = ((f.numX-1) << f.cellShift) - 1;
+    int maxY = ((f.numY-1) << f.cellShift) - 1;
 
     while (points--)
     {
-        CIwSVec2 dirToCentre = *v - rippleCentre;
-        int32 distToCentre = dirToCentre.GetLength() / g_TileSize;
-        int32 rippleHeight = distToCentre*20 + (g_RippleDuration)*7 + IW_GEOM_ONE/2;
-        if (distToCentre && rippleHeight >= 0)
-        {
-            dirToCentre.Normalise();
-            int ofs = IW_FIXED_MUL(IW_FIXED_MUL(g_TileSize*(4<<3), g_RippleDuration*2), IwGeomSin(rippleHeight));
-            *v += dirToCentre * ofs;//MAX(0, ofs);
-        }
+        // Find the cell containing this vertex (vertices off the edge of the field use the nearest edge)
+        int fx = MAX(0, MIN(maxX, v->x - f.originX));
+        int fy = MAX(0, MIN(maxY, v->y - f.originY));
+        int tx = fx & mask;
+        int ty = fy & mask;
+        int i = (fx >> f.cellShift) + (fy >> f.cellShift) * f.numX;
+
+        // Bilinear interpolation between the 4 surrounding nodes
+        int top = f.dx[i] + (((f.dx[i+1] - f.dx[i]) * tx) >> f.cellShift);
+        int bottom = f.dx[i+f.numX] + (((f.dx[i+f.numX+1] - f.dx[i+f.numX]) * tx) >> f.cellShift);
+        v->x += top + (((bottom - top) * ty) >> f.cellShift);
+
+        top = f.dy[i] + (((f.dy[i+1] - f.dy[i]) * tx) >> f.cellShift);
+        bottom = f.dy[i+f.numX] + (((f.dy[i+f.numX+1] - f.dy[i+f.numX]) * tx) >> f.cellShift);
+        v->y += top + (((bottom - top) * ty) >> f.cellShift);
+
         c++;
         v++;
     }
@@ -68,23 +142,15 @@ void RippleFunc(CIwSVec2* v, CIwColour* c, int32 points)
 // Input ////////////////////////////////////////////////////////////////////////
 //
 
-int input_x = 0;
-int input_y = 0;
-int input_rotation = 0;
-int old_input_y = 0;
+PlayerInput g_PlayerInput;
 
-static int autoRepeatTimer = 0;
-static int autoRepeatValue = 0;
-
-
-void UpdateInput(int deltaTimeMs)
+void UpdateInput()
 {
     s3ePointerUpdate();
     s3eKeyboardUpdate();
 
-    old_input_y = input_y;
-
-    input_y = input_x = input_rotation = 0;
+    PlayerInput& input = g_PlayerInput;
+    input.xMovement = input.rotation = input.down = 0;
 
     int xMovement = 0;
     if (s3eKeyboardGetState(s3eKeyAbsLeft) & S3E_KEY_STATE_DOWN)
@@ -92,16 +158,15 @@ void UpdateInput(int deltaTimeMs)
     if (s3eKeyboardGetState(s3eKeyAbsRight) & S3E_KEY_STATE_DOWN)
         xMovement++;
 
-    input_rotation = 0;
     if (s3eKeyboardGetState(s3eKeyAbsGameA) & S3E_KEY_STATE_PRESSED)
-        input_rotation = -1;
+        input.rotation = -1;
     if (s3eKeyboardGetState(s3eKeyAbsGameB) & S3E_KEY_STATE_PRESSED)
-        input_rotation = 1;
+        input.rotation = 1;
     if (s3eKeyboardGetState(s3eKeyAbsUp) & S3E_KEY_STATE_PRESSED)
-        input_rotation = -1;
+        input.rotation = -1;
 
     if (s3eKeyboardGetState(s3eKeyAbsDown) & S3E_KEY_STATE_DOWN)
-        input_y = 1;
+        input.down = 1;
 
     if (s3ePointerGetState(S3E_POINTER_BUTTON_SELECT) & S3E_POINTER_STATE_DOWN)
     {
@@ -114,41 +179,22 @@ void UpdateInput(int deltaTimeMs)
         if (s3ePointerGetState(S3E_POINTER_BUTTON_SELECT) & S3E_POINTER_STATE_PRESSED)
         {
             if (x == 0 && y==2)
-                input_rotation = -1;
+                input.rotation = -1;
             if (x == 2 && y==2)
-                input_rotation = 1;
+                input.rotation = 1;
         }
         if (x == 0 && y==3)
             xMovement--;
         if (x == 2 && y==3)
             xMovement++;
         if (x == 1 && y==3)
-            input_y = 1;
+            input.down = 1;
     }
 
     // Clamp xMovement to the range [-1,1]
     if (ABS(xMovement) > 1)
         xMovement = (xMovement < 0) ? -1 : 1;
-
-    if (xMovement != autoRepeatValue || xMovement == 0)
-    {
-        // Reset auto-repeat timer
-        autoRepeatValue = xMovement;
-        autoRepeatTimer = 0;
-        input_x = xMovement;
-    }
-    else
-    {
-        autoRepeatTimer += deltaTimeMs;
-        if (autoRepeatTimer >= 200)
-        {
-            // Faster auto-repeat after the first repeat
-            autoRepeatTimer = 100;
-            input_x = xMovement;
-        }
-        else
-            input_x = 0;
-    }
+    input.xMovement = xMovement;
 }
 
 void DrawTouchscreenButtons()
@@ -162,15 +208,15 @@ void DrawTouchscreenButtons()
     else
         size = 64;
 
-    Iw2DSetColour(0xff646464);
-    Iw2DSetAlphaMode(IW_2D_ALPHA_ADD);
-    DrawSpriteCentered(touchscreenButtonImage[0], size/2, displayHeight*5/8, size);
-    DrawSpriteCentered(touchscreenButtonImage[1], displayWidth-size/2, displayHeight*5/8, size);
-    DrawSpriteCentered(touchscreenButtonImage[2], size/2, displayHeight-size/2, size);
-    DrawSpriteCentered(touchscreenButtonImage[3], displayWidth/2, displayHeight-size/2, size);
-    DrawSpriteCentered(touchscreenButtonImage[4], displayWidth-size/2, displayHeight-size/2, size);
-    Iw2DSetAlphaMode(IW_2D_ALPHA_NONE);
-    Iw2DSetColour(0xffffffff);
+    RenderSetColour(0xff646464);
+    RenderSetAlphaMode(RENDER_ALPHA_ADD);
+    DrawSpriteCentered(IMAGE_TOUCHSCREEN_BUTTONS+0, size/2, displayHeight*5/8, size);
+    DrawSpriteCentered(IMAGE_TOUCHSCREEN_BUTTONS+1, displayWidth-size/2, displayHeight*5/8, size);
+    DrawSpriteCentered(IMAGE_TOUCHSCREEN_BUTTONS+2, size/2, displayHeight-size/2, size);
+    DrawSpriteCentered(IMAGE_TOUCHSCREEN_BUTTONS+3, displayWidth/2, displayHeight-size/2, size);
+    DrawSpriteCentered(IMAGE_TOUCHSCREEN_BUTTONS+4, displayWidth-size/2, displayHeight-size/2, size);
+    RenderSetAlphaMode(RENDER_ALPHA_NONE);
+    RenderSetColour(0xffffffff);
 }
 
 //
@@ -211,14 +257,80 @@ bool Grid::RowEmpty(int y) const
     return true;
 }
 
+// Release heap storage. Storage taken from an arena is released when the arena is reset
+void Grid::Free()
+{
+    if (!arena)
+    {
+        delete [] tile;
+        delete [] groupSizes;
+        delete [] groupStarts;
+        delete [] groupTiles;
+        delete [] columnTops;
+        delete [] columnBottoms;
+    }
+    tile = NULL;
+    groupSizes = NULL;
+    groupStarts = NULL;
+    groupTiles = NULL;
+    columnTops = NULL;
+    columnBottoms = NULL;
+    tileCapacity = columnCapacity = 0;
+    numGroups = 0;
+}
+
+// Allocate storage for the current size
+void Grid::Allocate()
+{
+    Free();
+
+    if (arena)
+    {
+        tile = arena->AllocArray<Tile>(width*height);
+        groupSizes = arena->AllocArray<int>(width*height);
+        groupStarts = arena->AllocArray<int>(width*height);
+        groupTiles = arena->AllocArray<int>(width*height);
+        columnTops = arena->AllocArray<int>(width);
+        columnBottoms = arena->AllocArray<int>(width);
+    }
+    else
+    {
+        tile = new Tile[width*height];
+        groupSizes = new int[width*height];
+        groupStarts = new int[width*height];
+        groupTiles = new int[width*height];
+        columnTops = new int[width];
+        columnBottoms = new int[width];
+    }
+    tileCapacity = width*height;
+    columnCapacity = width;
+}
+
+void Grid::Init(Arena* _arena, int newWidth, int newHeight)
+{
+    Free();
+    arena = _arena;
+    width = newWidth;
+    height = newHeight;
+    Allocate();
+    Clear();
+}
+
 void Grid::Resize(int newWidth, int newHeight)
 {
     if (width != newWidth || height != newHeight)
     {
         width = newWidth;
         height = newHeight;
-        delete [] tile;
-        tile = new Tile[width*height];
+
+        // The storage is only replaced if it's too small. Storage taken from an arena isn't given back until the arena
+        // is reset, so a grid using one mustn't grow
+        if (width*height > tileCapacity || width > columnCapacity)
+        {
+            IwAssertMsg(APP, !arena, ("A grid using an arena can't grow (to %dx%d)", width, height));
+            Allocate();
+        }
+        changeCount++;
     }
 }
 
@@ -227,6 +339,9 @@ Grid & Grid::operator = (Grid const & g)
     Resize(g.width, g.height);
 
     memcpy(tile, g.tile, width*height*sizeof(tile[0]));
+    memcpy(columnTops, g.columnTops, width*sizeof(int));
+    memcpy(columnBottoms, g.columnBottoms, width*sizeof(int));
+    changeCount++;
 
     numRotations = g.numRotations;
     currentRotation = g.currentRotation;
@@ -241,6 +356,12 @@ void Grid::Clear()
     numRotations = 4;
     for (int i=0; i<width*height; i++)
         tile[i].Clear();
+    for (int x=0; x<width; x++)
+    {
+        columnTops[x] = height;
+        columnBottoms[x] = -1;
+    }
+    changeCount++;
 }
 
 
@@ -261,6 +382,8 @@ const Tile & Grid::Get(int x, int y) const
 void Grid::SetTile(int x, int y, int col)
 {
     Get(x,y).SetCol(col);
+    UpdateColumn(x);
+    changeCount++;
 }
 
 
@@ -283,7 +406,6 @@ void Grid::Render(int rx, int ry) const
                     t.col-1,
                     x*g_TileSize + rx,
                     y*g_TileSize + ry,
-                    g_TileSize,
                     t.connect
                     );
             }
@@ -307,6 +429,7 @@ void Grid::Rotate(int r)
     r = r & 3;
 
     currentRotation = (currentRotation + r) % numRotations;
+    changeCount++;
 
     // Rotate the connection information (this is done by rotating the bit field)
     if (r)
@@ -328,12 +451,15 @@ void Grid::Rotate(int r)
             }
         }
     }
+
+    UpdateColumns();
 }
 
 
 void Grid::AddToWorld(Grid& g, int offsetX, int offsetY) const
 {
     // Copy any non-empty tiles from this grid into the specified target (with offset)
+    g.changeCount++;
     for (int x=0; x<width; x++)
     {
         for (int y=0; y<height; y++)
@@ -341,6 +467,12 @@ void Grid::AddToWorld(Grid& g, int offsetX, int offsetY) const
             if (Get(x,y))
                 g.Get(x+offsetX, y+offsetY) = Get(x,y);
         }
+
+        if (columnBottoms[x] >= 0)
+        {
+            g.columnTops[x+offsetX] = MIN(g.columnTops[x+offsetX], columnTops[x]+offsetY);
+            g.columnBottoms[x+offsetX] = MAX(g.columnBottoms[x+offsetX], columnBottoms[x]+offsetY);
+        }
     }
 }
 
@@ -367,97 +499,68 @@ bool Grid::Collide(Grid const & g, int ox, int oy) const
 }
 
 
-int Grid::UpdateConnections()
+// The tiles of a grid, as the algorithms in boardrules.h see them
+struct GridBoard
 {
-    // Links all similarly coloured tiles together.
-    // Returns the number of extra links added
-
-    int count = 0;
-    for (int y=0; y<height; y++)
-        for (int x=0; x<width; x++)
-            count += UpdateTileConnections(x,y);
-
-    // Divide count by 2, since the we count each connection twice
-    return count / 2;
-}
+    Grid& grid;
+
+    GridBoard(Grid& _grid) : grid(_grid) {}
+    int Width() const { return grid.width; }
+    int Height() const { return grid.height; }
+    int Colour(int i) const { return grid.tile[i].col; }
+    uint32_t Connections(int i) const { return grid.tile[i].connect; }
+    void SetConnections(int i, uint32_t connect) { grid.tile[i].connect = connect; }
+    int GroupId(int i) const { return grid.tile[i].groupId; }
+    void SetGroupId(int i, int id) { grid.tile[i].groupId = id; }
+
+    void MoveDown(int i)
+    {
+        int x = i % grid.width;
+        int y = i / grid.width;
+        grid.tile[i + grid.width] = grid.tile[i];
+        grid.tile[i].Clear();
+
+        // The highest and lowest tiles can only move down
+        if (grid.columnTops[x] == y)
+            grid.columnTops[x] = y+1;
+        if (grid.columnBottoms[x] == y)
+            grid.columnBottoms[x] = y+1;
+    }
+};
 
 
-int Grid::UpdateTileConnections(int x, int y)
+int Grid::UpdateConnections()
 {
-    // Links the specified tile to any adjacent tiles of the same colour
+    // Links all similarly coloured tiles together.
     // Returns the number of extra links added
 
-    Tile& t = Get(x,y);
-    if (t)
-    {
-        uint32 connect = 0;
-        if (x>0 && t.JoinsTo(Get(x-1,y)))
-            connect |= CONNECT_LEFT;
-        if (x<width-1 && t.JoinsTo(Get(x+1,y)))
-            connect |= CONNECT_RIGHT;
-        if (y>0 && t.JoinsTo(Get(x,y-1)))
-            connect |= CONNECT_UP;
-        if (y<height-1 && t.JoinsTo(Get(x,y+1)))
-            connect |= CONNECT_DOWN;
-
-        if (t.connect != connect)
-        {
-            int extraConnections = connect & ~t.connect;
-            t.connect = connect;
-
-            // Count the number of new connections added
-            int count = 0;
-            for (; extraConnections; extraConnections>>=1)
-                if (extraConnections & 1)
-                    count++;
-
-            return count;
-        }
-    }
-
-    return 0;
+    GridBoard board(*this);
+    int count = BoardUpdateConnections(board);
+    changeCount++;
+    return count;
 }
 
 
-void Grid::FloodFill(int x, int y, int id)
+void Grid::CreateGroups()
 {
-    // Recursively find all adjacent tiles of the same colour, and set their id.
-    // Also counts the number of tiles in the group (stored in the member variable 'groupSizes')
-    // This assumes the ids have been set to 0 first.
-
-    Tile& t = Get(x,y);
-
-    groupSizes[id]++;
-    t.groupId = id;
-
-    if (x>0 && t.CanFloodFillTo(Get(x-1,y)))
-        FloodFill(x-1, y, id);
-    if (x<width-1 && t.CanFloodFillTo(Get(x+1,y)))
-        FloodFill(x+1, y, id);
-    if (y>0 && t.CanFloodFillTo(Get(x,y-1)))
-        FloodFill(x, y-1, id);
-    if (y<height-1 && t.CanFloodFillTo(Get(x,y+1)))
-        FloodFill(x, y+1, id);
+    GridBoard board(*this);
+    numGroups = BoardCreateGroups(board, groupSizes, groupStarts, groupTiles);
+    groupsChangeCount = changeCount;
 }
 
 
-void Grid::CreateGroups()
+// Remove a group whose tiles have been cleared, numbering the groups after it down to fill the gap. This leaves the
+// ids as CreateGroups would set them, without finding the groups again
+void Grid::RemoveGroup(int id)
 {
-    // Clear group information
     for (int i=0; i<width*height; i++)
-        tile[i].groupId = -1;
+        if (tile[i].groupId > id)
+            tile[i].groupId--;
 
-    groupSizes.clear();
-
-    // Build new group information by floodfilling
-    for (int x=0; x<width; x++)
-        for (int y=0; y<height; y++)
-            if (Get(x,y) && Get(x,y).groupId == -1)
-            {
-                int id = groupSizes.size();
-                groupSizes.append(0);
-                FloodFill(x, y, id);
-            }
+    numGroups--;
+    memmove(groupSizes + id, groupSizes + id + 1, (numGroups - id)*sizeof(int));
+    memmove(groupStarts + id, groupStarts + id + 1, (numGroups - id)*sizeof(int));
+    groupsChangeCount = changeCount;
 }
 
 
@@ -467,51 +570,16 @@ bool Grid::MakeFall()
     // Returns true if anything moved.
     // This assumes CreateGroups has already been called
 
-    bool falling = false;
-
-    CIwArray<int> supported;
-    supported.resize(groupSizes.size());
-    for (uint32 i=0; i<supported.size(); i++)
-        supported[i] = 0;
+    // Scratch space, released when this returns
+    IwAssertMsg(APP, arena, ("MakeFall needs an arena for scratch space"));
+    ArenaScope scratch(*arena);
+    int* fallScratch = arena->AllocArray<int>(BoardFallScratchSize(width*height, numGroups));
 
-    while (1)
-    {
-        bool changed = false;
-
-        // Iterate from the bottom towards the top, finding unsupported groups which will need to fall
-        for (int y=height-1; y>=0; y--)
-        {
-            for (int x=0; x<width; x++)
-            {
-                // If the this tile's group isn't supported, check if it should be.
-                // (Either because it's at the bottom of the playing area, or it's resting on another supported group)
-                if (Get(x,y) && !supported[Get(x,y).groupId])
-                {
-                    if (y == height-1 ||
-                        (Get(x, y + 1) && supported[Get(x, y + 1).groupId]))
-                    {
-                        supported[Get(x, y).groupId] = 1;
-                        changed = true;
-                    }
-                }
-            }
-        }
-
-        // Keep re-scanning the tiles until we don't find any more supported ones
-        if (!changed)
-            break;
-    }
-
-    // Iterate from the bottom towards the top, moving unsupported groups downwards
-    for (int y=height-1; y>=0; y--)
-        for (int x=0; x<width; x++)
-            if (Get(x,y) && !supported[Get(x,y).groupId])
-            {
-                Get(x,y+1) = Get(x,y);
-                Get(x,y).Clear();
-                falling = true;
-            }
+    GridBoard board(*this);
+    bool falling = BoardMakeFall(board, numGroups, fallScratch);
 
+    if (falling)
+        changeCount++;
     return falling;
 }
 
@@ -522,90 +590,342 @@ int Grid::CheckForExplosions(int criticalMass, CIwVec2 & centre)
     // Returns the total number of tiles removed
     // Note: this will only remove one group at a time, for the benefit of the scoring system
 
-    CreateGroups();
+    // Removing a group doesn't change the others, so the groups are only found again if something else has changed
+    if (groupsChangeCount != changeCount)
+        CreateGroups();
 
     centre.x = centre.y = 0;
 
-    int explosions = 0;
-    int explodeGroup = -1;
-    for (int x=0; x<width; x++)
-        for (int y=0; y<height; y++)
-            if (Get(x,y) && groupSizes[Get(x,y).groupId]>=criticalMass)
-            {
-                if (explodeGroup == -1 || explodeGroup == Get(x, y).groupId)
-                {
-                    explosions++;
-                    explodeGroup = Get(x, y).groupId;
+    // Groups are numbered in the order their first tiles are reached going down each column from the left, so the
+    // first group big enough is the one with the lowest id
+    int explodeGroup = BoardNextExplosion(groupSizes, numGroups, criticalMass, -1);
 
-                    centre.x += x;
-                    centre.y += y;
-                }
-            }
+    if (explodeGroup == -1)
+        return 0;
 
-    if (explosions)
+    const int* tiles = groupTiles + groupStarts[explodeGroup];
+    int explosions = groupSizes[explodeGroup];
+    for (int i=0; i<explosions; i++)
     {
-        // Take average of tile positions
-        centre.x = centre.x / explosions;
-        centre.y = centre.y / explosions;
+        centre.x += tiles[i] % width;
+        centre.y += tiles[i] / width;
+    }
 
+    changeCount++;
+
+    // Take average of tile positions
+    centre.x = centre.x / explosions;
+    centre.y = centre.y / explosions;
+
+    // The lower effect qualities do without the ripple
+    if (g_EffectsManager->GetQualitySettings().rippleSpacing)
         g_RippleDuration = 500;
 
-        //Remember the ripple centre for the post transform callback
-        g_RippleCentre = (centre * IW_FIXED(g_TileSize));
+    //Remember the ripple centre for the post transform callback
+    g_RippleCentre = (centre * IW_FIXED(g_TileSize));
 
 
-        // convert into fixed point, and move to the middle of the tile
-        centre = (centre << IW_GEOM_POINT) + CIwVec2(IW_FIXED(0.5), IW_FIXED(0.5));
+    // convert into fixed point, and move to the middle of the tile
+    centre = (centre << IW_GEOM_POINT) + CIwVec2(IW_FIXED(0.5), IW_FIXED(0.5));
 
-        // Create fragments, and clear tiles
-        for (int x=0; x<width; x++)
-            for (int y=0; y<height; y++)
-                if (Get(x,y).groupId == explodeGroup)
-                {
-                    CIwVec2 p = (CIwVec2(x,y) << IW_GEOM_POINT) + CIwVec2(IW_FIXED(0.5), IW_FIXED(0.5));
-                    CIwVec2 v = (p - centre);
-                    v.x += random() % 2000 - 1000;
-                    v.y += random() % 2000 - 1000;
-                    v.Normalise();
+    // Create fragments, and clear tiles
+    for (int i=0; i<explosions; i++)
+    {
+        int x = tiles[i] % width;
+        int y = tiles[i] / width;
 
-                    g_EffectsManager->Add(new ExplosionFragment(p, v * IW_FIXED(27), Get(x,y).col));
+        CIwVec2 p = (CIwVec2(x,y) << IW_GEOM_POINT) + CIwVec2(IW_FIXED(0.5), IW_FIXED(0.5));
+        CIwVec2 v = (p - centre);
+        v.x += random() % 2000 - 1000;
+        v.y += random() % 2000 - 1000;
+        v.Normalise();
 
-                    g_EffectsManager->Add(new ExplosionFragment(p, v * IW_FIXED(60), Get(x,y).col));
+        g_EffectsManager->AddTileFragments(p, v);
 
-                    Get(x,y).Clear();
-                }
+        Get(x,y).Clear();
     }
 
+    RemoveGroup(explodeGroup);
+    UpdateColumns();
+
     return explosions;
 }
 
 
+// Find the highest and lowest tile in a column again
+void Grid::UpdateColumn(int x)
+{
+    int top = 0;
+    while (top < height && !Get(x,top))
+        top++;
+
+    int bottom = height-1;
+    while (bottom >= top && !Get(x,bottom))
+        bottom--;
+
+    columnTops[x] = top;
+    columnBottoms[x] = bottom;
+}
+
+
+// Find the highest and lowest tile in every column again (after the tiles have been changed directly)
+void Grid::UpdateColumns()
+{
+    for (int x=0; x<width; x++)
+        UpdateColumn(x);
+}
+
+
+// Returns the vertical offset at which 'piece', placed at (ox,oy), comes to rest if it's moved straight down.
+// (ox,oy) must be a position where it doesn't collide
+int Grid::LandingRow(Grid const & piece, int ox, int oy) const
+{
+    // While every column of the piece is above the highest tile in that column of this grid, the piece stops when
+    // the first of its columns reaches the top of the stack (or the bottom)
+    int landing = height;
+    bool aboveStack = true;
+    for (int x=0; x<piece.width && aboveStack; x++)
+    {
+        if (piece.columnBottoms[x] < 0)
+            continue;
+
+        int top = columnTops[x+ox];
+        if (piece.columnBottoms[x]+oy >= top)
+            aboveStack = false;
+        landing = MIN(landing, top-1 - piece.columnBottoms[x]);
+    }
+
+    // If the piece has been slid underneath an overhang, move it down a row at a time instead
+    if (!aboveStack)
+    {
+        landing = oy;
+        while (!piece.Collide(*this, ox, landing+1))
+            landing++;
+    }
+
+    IwAssertMsg(APP, !piece.Collide(*this, ox, landing) && piece.Collide(*this, ox, landing+1),
+        ("Column tops are out of date (piece at %d,%d lands at %d)", ox, oy, landing));
+    return landing;
+}
+
+
 
 //
 // PuzzleGame class ////////////////////////////////////////////////////////////////////////
 //
 
-PuzzleGame::PuzzleGame()
+// Use the defaults, or the parameter file named by the ParamsFile setting
+void LoadGameParams()
+{
+    g_GameParams = g_DefaultGameParams;
+
+    char filename[S3E_CONFIG_STRING_MAX] = {0};
+    if (s3eConfigGetString("Blocslot", "ParamsFile", filename) != S3E_RESULT_SUCCESS || !filename[0])
+        return;
+
+    s3eFile* f = s3eFileOpen(filename, "rb");
+    if (!f)
+    {
+        s3eDebugTracePrintf("Params: couldn't open %s, using the defaults", filename);
+        return;
+    }
+
+    // A file which fills the buffer (leaving no room for the terminator) would have to be cut short, which could leave
+    // out settings without the parser noticing, so it's rejected
+    static char text[GAME_PARAMS_FILE_MAX];
+    int size = s3eFileRead(text, 1, sizeof(text), f);
+    s3eFileClose(f);
+    if (size >= (int)sizeof(text))
+    {
+        s3eDebugTracePrintf("Params: %s is longer than %d bytes, using the defaults", filename, GAME_PARAMS_FILE_MAX - 1);
+        IwAssertMsg(APP, false, ("Parameter file %s is longer than %d bytes", filename, GAME_PARAMS_FILE_MAX - 1));
+        return;
+    }
+    text[size] = 0;
+
+    char error[128];
+    if (!GameParamsParse(g_GameParams, text, error, sizeof(error)))
+    {
+        s3eDebugTracePrintf("Params: %s in %s, using the defaults", error, filename);
+        IwAssertMsg(APP, false, ("Parameter file %s: %s", filename, error));
+    }
+}
+
+PuzzleGame::PuzzleGame() : arena(GAME_ARENA_PIECES_SIZE + g_GameParams.width*g_GameParams.height*GAME_ARENA_BYTES_PER_TILE)
 {
-    grid.Resize(GAME_WIDTH, GAME_HEIGHT);
+    s3eConfigGetInt("Blocslot", "GhostPiece", &s_DrawGhostPiece);
     Reset();
 }
 
+// Returns true if anything on screen moves without user input (used to choose the frame rate)
+bool PuzzleGame::IsAnimating() const
+{
+    return mode != MODE_GAME_OVER || g_RippleDuration || g_EffectsManager->IsActive();
+}
+
+// Everything is copied as it is, including the column tops and bottoms, so restoring doesn't need to work anything out
+void PuzzleGame::SaveState(GameSnapshot* snapshot) const
+{
+    snapshot->version = GAME_SNAPSHOT_VERSION;
+    snapshot->stateHash = StateHash();
+    snapshot->state = *this;
+    snapshot->gridWidth = grid.width;
+    snapshot->gridHeight = grid.height;
+    snapshot->gridNumGroups = grid.numGroups;
+    memcpy(snapshot->activePiece, activePiece.tile, sizeof(snapshot->activePiece));
+    memcpy(snapshot->activeColumnTops, activePiece.columnTops, sizeof(snapshot->activeColumnTops));
+    memcpy(snapshot->activeColumnBottoms, activePiece.columnBottoms, sizeof(snapshot->activeColumnBottoms));
+    snapshot->activeNumRotations = activePiece.numRotations;
+    snapshot->activeRotation = activePiece.currentRotation;
+    memcpy(snapshot->nextPiece, nextPiece.tile, sizeof(snapshot->nextPiece));
+    memcpy(snapshot->nextColumnTops, nextPiece.columnTops, sizeof(snapshot->nextColumnTops));
+    memcpy(snapshot->nextColumnBottoms, nextPiece.columnBottoms, sizeof(snapshot->nextColumnBottoms));
+    snapshot->nextNumRotations = nextPiece.numRotations;
+
+    // The play area follows
+    uint8* tail = (uint8*)(snapshot + 1);
+    memcpy(tail, grid.tile, grid.width*grid.height*sizeof(Tile));
+    tail += grid.width*grid.height*sizeof(Tile);
+    memcpy(tail, grid.columnTops, grid.width*sizeof(int));
+    tail += grid.width*sizeof(int);
+    memcpy(tail, grid.columnBottoms, grid.width*sizeof(int));
+}
+
+bool PuzzleGame::RestoreState(GameSnapshot const * snapshot)
+{
+    IwAssertMsg(APP, snapshot->version == GAME_SNAPSHOT_VERSION, ("Snapshot is from a different version (%d)", snapshot->version));
+    IwAssertMsg(APP, snapshot->gridWidth == grid.width && snapshot->gridHeight == grid.height,
+        ("Snapshot is of a %dx%d board, not %dx%d", snapshot->gridWidth, snapshot->gridHeight, grid.width, grid.height));
+
+    *static_cast<PuzzleState*>(this) = snapshot->state;
+    grid.numGroups = snapshot->gridNumGroups;
+    grid.changeCount++;
+    memcpy(activePiece.tile, snapshot->activePiece, sizeof(snapshot->activePiece));
+    memcpy(activePiece.columnTops, snapshot->activeColumnTops, sizeof(snapshot->activeColumnTops));
+    memcpy(activePiece.columnBottoms, snapshot->activeColumnBottoms, sizeof(snapshot->activeColumnBottoms));
+    activePiece.numRotations = snapshot->activeNumRotations;
+    activePiece.currentRotation = snapshot->activeRotation;
+    activePiece.changeCount++;
+    memcpy(nextPiece.tile, snapshot->nextPiece, sizeof(snapshot->nextPiece));
+    memcpy(nextPiece.columnTops, snapshot->nextColumnTops, sizeof(snapshot->nextColumnTops));
+    memcpy(nextPiece.columnBottoms, snapshot->nextColumnBottoms, sizeof(snapshot->nextColumnBottoms));
+    nextPiece.numRotations = snapshot->nextNumRotations;
+    nextPiece.currentRotation = 0;
+    nextPiece.changeCount++;
+
+    const uint8* tail = (const uint8*)(snapshot + 1);
+    memcpy(grid.tile, tail, grid.width*grid.height*sizeof(Tile));
+    tail += grid.width*grid.height*sizeof(Tile);
+    memcpy(grid.columnTops, tail, grid.width*sizeof(int));
+    tail += grid.width*sizeof(int);
+    memcpy(grid.columnBottoms, tail, grid.width*sizeof(int));
+
+    // The score display needs formatting again
+    scoreTextScore = scoreTextLevel = -1;
+
+    // The round trip must give back exactly the state which was saved
+    uint32 hash = StateHash();
+    IwAssertMsg(APP, hash == snapshot->stateHash, ("Restored state hashes to %08x rather than %08x", hash, snapshot->stateHash));
+    return hash == snapshot->stateHash;
+}
+
+bool PuzzleGame::SaveStateToFile(const char* filename) const
+{
+    int size = GameSnapshotSize(grid.width, grid.height);
+    GameSnapshot* snapshot = (GameSnapshot*)new uint8[size];
+    SaveState(snapshot);
+
+    s3eFile* f = s3eFileOpen(filename, "wb");
+    bool ok = f && s3eFileWrite(snapshot, size, 1, f) == 1;
+    if (f)
+        s3eFileClose(f);
+
+    delete [] (uint8*)snapshot;
+    return ok;
+}
+
+// The file must be from this version of the game, with the same board size. Otherwise (or if it's damaged) a new game
+// is started instead and this returns false
+bool PuzzleGame::RestoreStateFromFile(const char* filename)
+{
+    s3eFile* f = s3eFileOpen(filename, "rb");
+    if (!f)
+        return false;
+
+    int size = GameSnapshotSize(grid.width, grid.height);
+    GameSnapshot* snapshot = (GameSnapshot*)new uint8[size];
+    bool ok = s3eFileRead(snapshot, size, 1, f) == 1 &&
+        snapshot->version == GAME_SNAPSHOT_VERSION &&
+        snapshot->gridWidth == grid.width && snapshot->gridHeight == grid.height;
+    s3eFileClose(f);
+
+    if (ok && !RestoreState(snapshot))
+    {
+        Reset();
+        ok = false;
+    }
+
+    delete [] (uint8*)snapshot;
+    return ok;
+}
+
+// FNV-1a, a word at a time. The simulation state is made up of 32-bit fields, so there's no padding to hash
+static uint32 HashWords(uint32 hash, const void* data, int size)
+{
+    const uint32* words = (const uint32*)data;
+    for (int i=0; i<size/4; i++)
+        hash = (hash ^ words[i]) * 16777619u;
+    return hash;
+}
+
+// Hash of everything in the simulation, used to check that a replay matches the original game.
+// This is folded into checkHash once per piece, which is cheap enough to leave on all the time
+uint32 PuzzleGame::StateHash() const
+{
+    uint32 hash = 2166136261u;
+    hash = HashWords(hash, static_cast<PuzzleState const *>(this), sizeof(PuzzleState));
+    hash = HashWords(hash, grid.tile, grid.width*grid.height*sizeof(Tile));
+    hash = HashWords(hash, &grid.numGroups, sizeof(int));
+    hash = HashWords(hash, activePiece.tile, activePiece.width*activePiece.height*sizeof(Tile));
+    hash = HashWords(hash, &activePiece.currentRotation, sizeof(int));
+    hash = HashWords(hash, nextPiece.tile, nextPiece.width*nextPiece.height*sizeof(Tile));
+    return hash;
+}
+
 // Reset game (used when a new game starts)
 void PuzzleGame::Reset()
+{
+    // Seed the piece generator from the Skillz random number generator, to ensure fair play
+    Start((uint32)SkillzGetRandomNumberInRange(0, 0x7fffffff));
+}
+
+// Start a new game, with the pieces chosen by the specified seed
+void PuzzleGame::Start(uint32 seed)
 {
     g_EffectsManager->Clear();
+    AllocBeginGame();
 
-    // Seed random number generator
+    // Nothing from the previous game is kept, so the arena can be reused from the start
+    arena.Reset();
+    grid.Init(&arena, g_GameParams.width, g_GameParams.height);
+    activePiece.Init(&arena, PIECE_SIZE, PIECE_SIZE);
+    nextPiece.Init(&arena, PIECE_SIZE, PIECE_SIZE);
+
+    // Seed random number generator (only used for effects)
     srand(time(NULL));
 
+    random.Seed(seed);
+    RecordingStartGame(seed);
+
     score = 0;
     totalPieceCount = 0;
     level = 1;
+    scoreTextScore = scoreTextLevel = -1;
+    autoRepeatValue = autoRepeatTimer = 0;
+    lastDown = 0;
+    checkHash = 0;
 
-
-    grid.Clear();
-    CreateRandomPiece(nextPiece, coloursPerLevel[level]);
+    CreateRandomPiece(nextPiece, nextPieceType, nextPieceColour);
     NewPiece(); // Makes the initially created piece active, and creates a new "next piece"
 }
 
@@ -633,72 +953,124 @@ void PuzzleGame::Render()
             previewTop = true;
     }
 
+    // Work out the top-left corner of where we want the main game area drawn.
+    // This is used as the origin, which reduces the complexity of the actual render functions
+    int originX = displayWidth/2  - centeringWidth/2;
+    int originY = displayHeight/2 - centeringHeight/2;
+    if (previewTop)
+        originY += 3 * g_TileSize;
+
 #ifndef IW_MKF_IW2D_LITE
+    // The ripple only applies to the playing area, next piece preview and effects
     if (g_RippleDuration)
-        Iw2DSetPostTransformFn(RippleFunc);
+    {
+        s_RippleField.Build(g_RippleCentre + CIwSVec2(originX, originY),
+            originX - 5*g_TileSize, originY - 5*g_TileSize, (grid.width + 11)*g_TileSize, (grid.height + 7)*g_TileSize,
+            g_EffectsManager->GetQualitySettings().rippleSpacing);
+    }
 #endif
 
+    // The overall background, the playing area's background and the settled tiles only change when the grid does,
+    // so they're drawn into the cached layer. The ripple distorts the playing area, so the layer isn't used while it's active
+    {
+        PROFILE_SCOPE(PROFILE_RENDER_BACKGROUND);
+        if (RenderBeginLayer(grid.changeCount, !g_RippleDuration))
+        {
+            DrawBG(IMAGE_BACKGROUND, 0, 0, displayWidth, displayHeight);
 
-    // Draw overall background
-    DrawBG(backgroundImage, 0, 0, displayWidth, displayHeight);
-
-    // Set the 2D transform to have a translation to the top-left corner of where we want
-    // the main game area drawn. This reduces the complexity of the actual render functions
-    CIwMat2D trans = CIwMat2D::g_Identity;
-    trans.t.x = int16( displayWidth/2  - centeringWidth/2 );
-    trans.t.y = int16( displayHeight/2 - centeringHeight/2 );
-    if (previewTop)
-        trans.t.y += 3 * g_TileSize;
-    Iw2DSetTransformMatrix(trans);
-
-    DrawBlackBG(0, 0, g_TileSize*grid.width, g_TileSize*grid.height);
+            RenderSetOrigin(originX, originY);
+            RenderSetRipple(g_RippleDuration != 0);
+            DrawBlackBG(0, 0, g_TileSize*grid.width, g_TileSize*grid.height);
+            grid.Render(0, 0);
+        }
+        RenderEndLayer();
+    }
 
-    // Draw playing area and active piece
-    grid.Render(0, 0);
-    if (mode == MODE_ACTIVE_PIECE)
-        activePiece.Render(piecePos.x*g_TileSize, piecePos.y*g_TileSize);
+    RenderSetOrigin(originX, originY);
+    RenderSetRipple(g_RippleDuration != 0);
 
-    // Draw next piece indicator
-    if (mode != MODE_GAME_OVER)
     {
-        if (previewRight)
+        PROFILE_SCOPE(PROFILE_RENDER_BOARD);
+
+        // Draw the ghost piece dimmed, in a batch of its own (anything drawn before it is submitted first, so that only
+        // the ghost is dimmed)
+        if (mode == MODE_ACTIVE_PIECE && s_DrawGhostPiece)
         {
-            int nextPieceX = grid.width*g_TileSize + g_TileSize/2;
-            nextPiece.Render(nextPieceX, 0);
+            int landing = grid.LandingRow(activePiece, piecePos.x, piecePos.y);
+            if (landing != piecePos.y)
+            {
+                RenderFlushTiles();
+                activePiece.Render(piecePos.x*g_TileSize, landing*g_TileSize);
+                RenderSetColour(0xff808080);
+                RenderSetAlphaMode(RENDER_ALPHA_HALF);
+                RenderFlushTiles();
+                RenderSetAlphaMode(RENDER_ALPHA_NONE);
+                RenderSetColour(0xffffffff);
+            }
         }
-        if (previewTop)
+
+        // Draw active piece
+        if (mode == MODE_ACTIVE_PIECE)
+            activePiece.Render(piecePos.x*g_TileSize, piecePos.y*g_TileSize);
+
+        // Draw next piece indicator
+        if (mode != MODE_GAME_OVER)
         {
-            nextPiece.Render(g_TileSize*2, g_TileSize*-4);
+            if (previewRight)
+            {
+                int nextPieceX = grid.width*g_TileSize + g_TileSize/2;
+                nextPiece.Render(nextPieceX, 0);
+            }
+            if (previewTop)
+            {
+                nextPiece.Render(g_TileSize*2, g_TileSize*-4);
+            }
         }
+
+        // Submit all the tiles above in one draw
+        RenderFlushTiles();
     }
 
     // Draw effects
-    g_EffectsManager->Render();
+    {
+        PROFILE_SCOPE(PROFILE_RENDER_EFFECTS);
+        g_EffectsManager->Render();
+    }
 
-    // Draw player's score
-    char scoreString[32];
-    sprintf(scoreString, "%s %d\n%s %d", g_Localisation[ID_SCORE], score, g_Localisation[ID_LEVEL], level);
-    Iw2DDrawString(scoreString,
-        CIwSVec2(0,0), CIwSVec2((int16)displayWidth, (int16)displayHeight),
-        IW_2D_FONT_ALIGN_LEFT, IW_2D_FONT_ALIGN_TOP);
+    RenderSetRipple(false);
 
-    if (mode == MODE_GAME_OVER)
     {
-        Iw2DDrawString(g_Localisation[ID_GAME_OVER],
-            CIwSVec2(0,0), CIwSVec2(g_TileSize*grid.width,g_TileSize*grid.height),
-            IW_2D_FONT_ALIGN_CENTRE, IW_2D_FONT_ALIGN_CENTRE);
+        PROFILE_SCOPE(PROFILE_RENDER_TEXT);
+
+        // Draw player's score
+        if (score != scoreTextScore || level != scoreTextLevel)
+        {
+            scoreTextScore = score;
+            scoreTextLevel = level;
+
+            char scoreString[MAX_RENDER_TEXT];
+            snprintf(scoreString, sizeof(scoreString), "%s %d\n%s %d", g_Localisation[ID_SCORE], score, g_Localisation[ID_LEVEL], level);
+            scoreText.Set(scoreString);
+        }
+        RenderDrawText(scoreText,
+            0, 0, displayWidth, displayHeight,
+            IW_2D_FONT_ALIGN_LEFT, IW_2D_FONT_ALIGN_TOP);
+
+        if (mode == MODE_GAME_OVER)
+        {
+            gameOverText.Set(g_Localisation[ID_GAME_OVER]);
+            RenderDrawText(gameOverText,
+                0, 0, g_TileSize*grid.width, g_TileSize*grid.height,
+                IW_2D_FONT_ALIGN_CENTRE, IW_2D_FONT_ALIGN_CENTRE);
+        }
     }
 
     // Reset screen space origin
-    Iw2DSetTransformMatrix(CIwMat2D::g_Identity);
-
-#ifndef IW_MKF_IW2D_LITE
-    if (g_RippleDuration)
-        Iw2DSetPostTransformFn(NULL);
-#endif
+    RenderSetOrigin(0, 0);
 
     if (g_DrawTouchscreenButtons && mode != MODE_GAME_OVER)
     {
+        PROFILE_SCOPE(PROFILE_RENDER_BUTTONS);
         DrawTouchscreenButtons();
     }
 }
@@ -725,73 +1097,23 @@ bool PuzzleGame::MovePiece(int x, int y, int rotation)
 }
 
 // Create a new piece with random shape and colour
-void PuzzleGame::CreateRandomPiece(Grid & newPiece, int numColours)
+void PuzzleGame::CreateRandomPiece(Grid & newPiece, int & type, int & colour)
 {
-    newPiece.Resize(5,5);
+    type = random.Range(0, NUM_PIECE_TYPES);
+    colour = random.Range(1, g_GameParams.colours[level]+1);
+    BuildPiece(newPiece, type, colour);
+}
+
+// Create a piece with the specified shape and colour
+void PuzzleGame::BuildPiece(Grid & newPiece, int type, int col)
+{
+    newPiece.Resize(PIECE_SIZE, PIECE_SIZE);
     newPiece.Clear();
 
-    // Use Skillz random number generator to ensure fair play
-    int pieceType = SkillzGetRandomNumberInRange(0, 7);
-    int col = SkillzGetRandomNumberInRange(1, numColours+1);
-    switch (pieceType)
-    {
-    case 0:
-        // 2x2 Square
-        newPiece.SetTile(1,1,col);
-        newPiece.SetTile(1,2,col);
-        newPiece.SetTile(2,1,col);
-        newPiece.SetTile(2,2,col);
-        newPiece.numRotations = 1;
-        break;
-    case 1:
-        // 1x4 Long thin piece
-        newPiece.SetTile(0,2,col);
-        newPiece.SetTile(1,2,col);
-        newPiece.SetTile(2,2,col);
-        newPiece.SetTile(3,2,col);
-        newPiece.numRotations = 2;
-        break;
-    case 2:
-        // 'Z' shaped piece
-        newPiece.SetTile(1,1,col);
-        newPiece.SetTile(2,1,col);
-        newPiece.SetTile(2,2,col);
-        newPiece.SetTile(3,2,col);
-        newPiece.numRotations = 2;
-        break;
-    case 3:
-        // 'S' shaped piece
-        newPiece.SetTile(1,2,col);
-        newPiece.SetTile(2,2,col);
-        newPiece.SetTile(2,1,col);
-        newPiece.SetTile(3,1,col);
-        newPiece.numRotations = 2;
-        break;
-    case 4:
-        // 'T' shaped piece
-        newPiece.SetTile(2,1,col);
-        newPiece.SetTile(1,2,col);
-        newPiece.SetTile(2,2,col);
-        newPiece.SetTile(3,2,col);
-        newPiece.numRotations = 4;
-        break;
-    case 5:
-        // Backwards 'L' shaped piece
-        newPiece.SetTile(1,1,col);
-        newPiece.SetTile(1,2,col);
-        newPiece.SetTile(2,2,col);
-        newPiece.SetTile(3,2,col);
-        newPiece.numRotations = 4;
-        break;
-    case 6:
-        // 'L' shaped piece
-        newPiece.SetTile(3,1,col);
-        newPiece.SetTile(1,2,col);
-        newPiece.SetTile(2,2,col);
-        newPiece.SetTile(3,2,col);
-        newPiece.numRotations = 4;
-        break;
-    }
+    PieceShape const & shape = pieceShapes[type];
+    for (int i=0; i<4; i++)
+        newPiece.SetTile(shape.tiles[i][0], shape.tiles[i][1], col);
+    newPiece.numRotations = shape.numRotations;
 
     // Link tiles together
     newPiece.UpdateConnections();
@@ -800,6 +1122,8 @@ void PuzzleGame::CreateRandomPiece(Grid & newPiece, int numColours)
 void PuzzleGame::NewPiece()
 {
     activePiece = nextPiece;
+    activePieceType = nextPieceType;
+    activePieceColour = nextPieceColour;
 
     piecePos.x = (grid.width - activePiece.width)/2;
     piecePos.y = 0;
@@ -815,13 +1139,14 @@ void PuzzleGame::NewPiece()
 
     // Count number of pieces created, and increase the difficulty level if necessary
     totalPieceCount++;
-    if (level < 9 && totalPieceCount > piecesLevelBoundary[level])
+    if (level < MAX_LEVEL && totalPieceCount > g_GameParams.levelPieces[level])
     {
         level++;
+        TraceInstant(TRACE_LEVEL, level);
     }
 
     // Create a new 'next piece'
-    CreateRandomPiece(nextPiece, coloursPerLevel[level]);
+    CreateRandomPiece(nextPiece, nextPieceType, nextPieceColour);
 
     // Reset piece-related variables for new piece
     timer = 0;
@@ -834,11 +1159,15 @@ void PuzzleGame::NewPiece()
         // Can't spawn new piece without it overlapping existing tiles.
         // Game over!
         mode = MODE_GAME_OVER;
+        AllocEndGame();
     }
     else
     {
         mode = MODE_ACTIVE_PIECE;
     }
+
+    checkHash = StateHash();
+    TraceInstant(TRACE_NEW_PIECE);
 }
 
 // Add the active piece to the world
@@ -846,8 +1175,10 @@ void PuzzleGame::LandPiece()
 {
     activePiece.AddToWorld(grid, piecePos.x, piecePos.y);
     activePiece.Clear();
+    activePieceType = -1;
 
     int c = grid.UpdateConnections();
+    TraceInstant(TRACE_LAND_PIECE);
 
     grid.CreateGroups();
 
@@ -855,8 +1186,7 @@ void PuzzleGame::LandPiece()
     timer = 0;
 
     // Score points for adding another piece to the world
-    // More points for pieces which fit together nicely (measured by the number of new connections created)
-    score += c * c * 10 + 10;
+    score += LandingScore(g_GameParams, c);
 }
 
 // Check for explosions and give score for them.
@@ -864,7 +1194,7 @@ void PuzzleGame::LandPiece()
 bool PuzzleGame::Explode()
 {
     CIwVec2 explosionCenter;
-    int c = grid.CheckForExplosions(EXPLODE_THRESHOLD, explosionCenter);
+    int c = grid.CheckForExplosions(g_GameParams.explodeThreshold, explosionCenter);
 
     if (c == 0)
     {
@@ -873,24 +1203,23 @@ bool PuzzleGame::Explode()
     else
     {
         // Things blew up - give score reward
-        // Extra points for blowing up larger groups of tiles
-        int extra = (c - EXPLODE_THRESHOLD) / 4;
-        int scoreAdd = 300 + extra * 100 + extra * extra * 100;
+        int scoreAdd = ExplosionScore(g_GameParams, c);
 
         score += scoreAdd * multiplier;
+        TraceInstant(TRACE_EXPLODE, c, multiplier);
 
         // Create a floating text object to inform the user of the point gain
-        char scoreString[32];
+        char scoreString[MAX_SCORE_TEXT];
         if (multiplier>1)
-            sprintf(scoreString, "%dx%d", scoreAdd, multiplier);
+            snprintf(scoreString, sizeof(scoreString), "%dx%d", scoreAdd, multiplier);
         else
-            sprintf(scoreString, "%d", scoreAdd);
+            snprintf(scoreString, sizeof(scoreString), "%d", scoreAdd);
 
-        g_EffectsManager->Add(new FloatText(explosionCenter, scoreString));
+        g_EffectsManager->AddScoreText(explosionCenter, scoreString, scoreAdd * multiplier);
 
 
         // Increase multiplier so chain reactions are worth more points
-        if (multiplier < 64)
+        if (multiplier < g_GameParams.maxMultiplier)
             multiplier *= 2;
 
         // Delay next logical update to give the player a bit more time to see chain reactions
@@ -934,18 +1263,18 @@ void PuzzleGame::ApplyUserInput(int & xMovement, int & rotation)
     }
 }
 
-void PuzzleGame::Update(int deltaTimeMs)
+void PuzzleGame::Update(int deltaTimeMs, PlayerInput const & input)
 {
-    g_EffectsManager->Update(deltaTimeMs);
+    {
+        PROFILE_SCOPE(PROFILE_UPDATE_EFFECTS);
+        g_EffectsManager->Update(deltaTimeMs);
+    }
 
-    //countdown ripple effect
+    //countdown ripple effect (stopping it early if the effect quality has dropped too low for it)
     g_RippleDuration -= deltaTimeMs;
-    if (g_RippleDuration < 0)
+    if (g_RippleDuration < 0 || !g_EffectsManager->GetQualitySettings().rippleSpacing)
         g_RippleDuration = 0;
 
-    // Accumulate time
-    timer += deltaTimeMs;
-
     if (s3eKeyboardGetState(s3eKeyR) & S3E_KEY_STATE_PRESSED)
     {
         // Reset gameplay (for testing)
@@ -954,9 +1283,12 @@ void PuzzleGame::Update(int deltaTimeMs)
 
     if (s3eKeyboardGetState(s3eKeyL) & S3E_KEY_STATE_PRESSED)
     {
-        // Increase level (for testing)
-        if (level < 9)
+        // Increase level (for testing). This isn't recorded, so recordings of games where it's used won't verify
+        if (level < MAX_LEVEL)
+        {
             level++;
+            TraceInstant(TRACE_LEVEL, level);
+        }
     }
 
     if (s3eKeyboardGetState(s3eKeyAbsBSK) & S3E_KEY_STATE_PRESSED)
@@ -967,6 +1299,9 @@ void PuzzleGame::Update(int deltaTimeMs)
         return;
     }
 
+    Step(deltaTimeMs, input);
+    RecordingTick(deltaTimeMs, input, *this);
+
     if (mode == MODE_GAME_OVER)
     {
         // Wait briefly before accepting input so the player doesn't accidentally skip the game over screen.
@@ -987,8 +1322,42 @@ void PuzzleGame::Update(int deltaTimeMs)
             }
         }
     }
-    else if (mode == MODE_EXPLODING)
+}
+
+// Advance the simulation. This only depends on the state and the input, so replaying the same inputs from the same
+// seed always gives the same result
+void PuzzleGame::Step(int deltaTimeMs, PlayerInput const & input)
+{
+    // Accumulate time
+    timer += deltaTimeMs;
+
+    // Sideways movement repeats while the direction is held, after a delay
+    int inputX = 0;
+    if (input.xMovement != autoRepeatValue || input.xMovement == 0)
+    {
+        // Reset auto-repeat timer
+        autoRepeatValue = input.xMovement;
+        autoRepeatTimer = 0;
+        inputX = input.xMovement;
+    }
+    else
+    {
+        autoRepeatTimer += deltaTimeMs;
+        if (autoRepeatTimer >= 200)
+        {
+            // Faster auto-repeat after the first repeat
+            autoRepeatTimer = 100;
+            inputX = input.xMovement;
+        }
+    }
+
+    // Dropping starts when the button is first pressed
+    bool downPressed = input.down && !lastDown;
+    lastDown = input.down;
+
+    if (mode == MODE_EXPLODING)
     {
+        PROFILE_SCOPE(PROFILE_UPDATE_EXPLODE);
         if (timer >= 100)
         {
             timer = 0;
@@ -1011,6 +1380,7 @@ void PuzzleGame::Update(int deltaTimeMs)
     }
     else if (mode == MODE_FALLING)
     {
+        PROFILE_SCOPE(PROFILE_UPDATE_FALL);
         if (timer >= 5*20)
         {
             timer = 0;
@@ -1034,17 +1404,18 @@ void PuzzleGame::Update(int deltaTimeMs)
     }
     else if (mode == MODE_ACTIVE_PIECE)
     {
-        int rotation = input_rotation;
-        int xMovement = input_x;
-        int down = (input_y>0);
+        PROFILE_SCOPE(PROFILE_UPDATE_MOVE);
+        int rotation = input.rotation;
+        int xMovement = inputX;
+        int down = input.down;
 
         ApplyUserInput(xMovement, rotation);
 
-        int gravityTime = gravityPerLevel[level];
+        int gravityTime = g_GameParams.gravity[level];
 
         int downTime = MIN(gravityTime/2, 80);
 
-        if (input_y>0 && old_input_y<=0)
+        if (downPressed)
             timer = downTime;
 
         while (timer > gravityTime || (down && timer >= downTime))
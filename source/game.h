@@ -13,8 +13,11 @@
 #ifndef _GAME_H
 #define _GAME_H
 
-#include "IwArray.h"
 #include "IwGeom.h"
+#include "arena.h"
+#include "gameparams.h"
+#include "gamerules.h"
+#include "rendertext.h"
 
 enum GameMode
 {
@@ -24,26 +27,34 @@ enum GameMode
 
 extern GameMode g_GameMode;
 
-// Bitfield used for remembering which directions from a tile contain a connected tile
-enum ConnectFlags
-{
-    CONNECT_UP    = 1<<0,
-    CONNECT_LEFT  = 1<<1,
-    CONNECT_DOWN  = 1<<2,
-    CONNECT_RIGHT = 1<<3,
-};
+// Parameters the game is played with (the defaults, unless ParamsFile is set in app.icf)
+extern GameParams g_GameParams;
 
-// Width and height of the playing area
-#define GAME_WIDTH  10
-#define GAME_HEIGHT 16
+// Set g_GameParams. Called at startup, before anything depends on the size of the board
+void LoadGameParams();
 
-// Number of different colour tiles that are used
-#define MAX_NUM_COLOURS 6
+// Size of the buffer parameter files are read into. Files of GAME_PARAMS_FILE_MAX bytes or more are rejected
+#define GAME_PARAMS_FILE_MAX 4096
 
-// Number of adjacent tiles of the same colour needed before they explode
-#define EXPLODE_THRESHOLD 12
+// Size of the arena holding a game's grids and scratch space. GAME_ARENA_BYTES_PER_TILE is comfortably more than a tile
+// of the play area needs (the tile, its column and group information, and the scratch MakeFall uses for it), and
+// GAME_ARENA_PIECES_SIZE more than the two pieces need
+#define GAME_ARENA_BYTES_PER_TILE   64
+#define GAME_ARENA_PIECES_SIZE      4096
 
-void UpdateInput(int deltaTimeMs);
+// Player input for one update
+struct PlayerInput
+{
+    int xMovement;  // Sideways direction held: -1, 0 or 1
+    int rotation;   // Rotation pressed this update: -1, 0 or 1
+    int down;       // Non-zero while the drop button is held
+};
+
+// Input read by UpdateInput
+extern PlayerInput g_PlayerInput;
+
+// Read the keyboard and touchscreen into g_PlayerInput
+void UpdateInput();
 
 // Class representing a single square in the game.
 struct Tile
@@ -69,47 +80,58 @@ struct Tile
         return col != 0;
     }
 
-    bool JoinsTo(Tile const & other) const
-    {
-        return col == other.col;
-    }
-
-    bool CanFloodFillTo(Tile const & other) const
-    {
-        return col == other.col && other.groupId == -1;
-    }
-
     void RotateConnections(int r);
 };
 
 // Container class for holding a 2 dimensional array of tiles
 // This is used both for the main play area and the individual pieces before they are added to the main play area
+// The storage comes from an arena if one has been set with Init, otherwise from the heap.
+// The highest and lowest tile in each column are kept up to date as the tiles change, so that finding where a piece
+// lands doesn't need to move it down a row at a time.
+// Finding the groups, exploding one and making things fall each take time in proportion to the number of tiles at
+// most, and don't recurse, so they scale to large boards (see BLOCSLOT_MEGA_BOARD in gamerules.h). The algorithms are
+// in boardrules.h, shared with the batch environment.
 struct Grid
 {
     int width,height;
+    int tileCapacity;       // Tiles and columns the storage has room for, which can be more than the current size
+    int columnCapacity;
     Tile *tile;
-    CIwArray <int> groupSizes;
+    int *groupSizes;        // Number of tiles in each group (one entry per tile, the most groups there can be)
+    int *groupStarts;       // Where each group's tiles are in groupTiles
+    int *groupTiles;        // Index of each tile in a group, group by group
+    int *columnTops;        // Row of the highest tile in each column (height if the column is empty)
+    int *columnBottoms;     // Row of the lowest tile in each column (-1 if the column is empty)
+    int numGroups;
+    Arena *arena;
     int numRotations;
     int currentRotation;
+    uint32 changeCount;     // Incremented whenever the tiles change (used to tell when the cached board needs redrawing)
+    uint32 groupsChangeCount;   // changeCount when the groups were last found
 
-    void FloodFill(int x, int y, int id);
+    void RemoveGroup(int id);
+    void Allocate();
+    void Free();
+    void UpdateColumn(int x);
 
 public:
 
-    Grid() : width(0), height(0), tile(NULL), numRotations(4), currentRotation(0)
+    Grid() : width(0), height(0), tileCapacity(0), columnCapacity(0), tile(NULL), groupSizes(NULL), groupStarts(NULL), groupTiles(NULL), columnTops(NULL), columnBottoms(NULL), numGroups(0), arena(NULL), numRotations(4), currentRotation(0), changeCount(0), groupsChangeCount(0)
     {
     }
 
-    Grid(Grid const & g) : width(0), height(0), tile(NULL), numRotations(4), currentRotation(0)
+    Grid(Grid const & g) : width(0), height(0), tileCapacity(0), columnCapacity(0), tile(NULL), groupSizes(NULL), groupStarts(NULL), groupTiles(NULL), columnTops(NULL), columnBottoms(NULL), numGroups(0), arena(NULL), numRotations(4), currentRotation(0), changeCount(0), groupsChangeCount(0)
     {
         *this = g;
     }
 
     ~Grid()
     {
-        delete [] tile;
+        Free();
     }
 
+    // Allocate empty storage from 'arena' (which must outlive the grid, or be reset before the grid is next used)
+    void Init(Arena* _arena, int newWidth, int newHeight);
     bool RowEmpty(int y) const;
     void Resize(int newWidth, int newHeight);
     Grid & operator = (Grid const & g);
@@ -123,14 +145,16 @@ public:
     void AddToWorld(Grid& g, int offsetX, int offsetY) const;
     bool Collide(Grid const & g, int ox, int oy) const;
     int UpdateConnections();
-    int UpdateTileConnections(int x, int y);
     void CreateGroups();
     bool MakeFall();
     int CheckForExplosions(int criticalMass, CIwVec2 & centre);
+    void UpdateColumns();
+    int LandingRow(Grid const & piece, int ox, int oy) const;
 };
 
 
-struct PuzzleGame
+// Everything in the simulation other than the grids, as plain data (see GameSnapshot)
+struct PuzzleState
 {
     enum UpdateMode
     {
@@ -140,9 +164,6 @@ struct PuzzleGame
         MODE_GAME_OVER,     // The game is over
     };
 
-    Grid grid;          // Main play area
-    Grid activePiece;   // Active piece (i.e. the one which the user can move)
-    Grid nextPiece;     // Next piece
     CIwVec2 piecePos;   // Position of active piece in the main play area
     int timer;          // Millisecond accumulator used for speed regulation
     UpdateMode mode;    // State of simulation
@@ -152,18 +173,81 @@ struct PuzzleGame
     int level;          // Difficulty level. Starts at 1, and goes up to 9
     int totalPieceCount;    // Counter of pieces used. Used to determine when to increase the difficulty level.
     int multiplier;         // Score multiplier. Used to reward combos. Reset to 1 whenever a new piece is added
+    int activePieceType;    // Shape and colour of the active piece (type is -1 once it has landed)
+    int activePieceColour;
+    int nextPieceType;
+    int nextPieceColour;
+    GameRandom random;      // Chooses the pieces
+    int autoRepeatValue;    // Sideways direction being held, and the time it has been held for (for auto-repeat)
+    int autoRepeatTimer;
+    int lastDown;           // Whether the drop button was held on the previous update
+    uint32 checkHash;       // Rolling hash of the whole state, updated each time a piece is created (see StateHash)
+};
+
+#define GAME_SNAPSHOT_VERSION 4
+
+// Snapshot of the whole simulation, used to save and restore a game (e.g. when the application is paused, see main.cpp).
+// It's plain data with no pointers, so snapshots can be copied with memcpy or written to a file.
+// The play area follows the fields below: gridWidth*gridHeight tiles, then the gridWidth column tops and the gridWidth
+// column bottoms. A snapshot therefore takes GameSnapshotSize() bytes for its own board rather than for the largest one.
+struct GameSnapshot
+{
+    uint32 version;     // GAME_SNAPSHOT_VERSION
+    uint32 stateHash;   // StateHash() when the snapshot was taken, checked once it has been restored
+    PuzzleState state;
+    int gridWidth;      // Size of the play area
+    int gridHeight;
+    int gridNumGroups;  // Groups are kept while things are falling
+    Tile activePiece[PIECE_SIZE*PIECE_SIZE];
+    int activeColumnTops[PIECE_SIZE];
+    int activeColumnBottoms[PIECE_SIZE];
+    int activeNumRotations;
+    int activeRotation;
+    Tile nextPiece[PIECE_SIZE*PIECE_SIZE];
+    int nextColumnTops[PIECE_SIZE];
+    int nextColumnBottoms[PIECE_SIZE];
+    int nextNumRotations;
+};
+
+// Bytes taken by a snapshot of a game on a 'width' by 'height' board
+inline int GameSnapshotSize(int width, int height)
+{
+    return (int)(sizeof(GameSnapshot) + width*height*sizeof(Tile) + width*2*sizeof(int));
+}
+
+struct PuzzleGame : public PuzzleState
+{
+    Arena arena;        // Storage for the grids below, and scratch space. Reset when a new game starts
+    Grid grid;          // Main play area
+    Grid activePiece;   // Active piece (i.e. the one which the user can move)
+    Grid nextPiece;     // Next piece
+    RenderText scoreText;   // Score and level display, only formatted again when either changes
+    int scoreTextScore;
+    int scoreTextLevel;
+    RenderText gameOverText;
 
     PuzzleGame();
     void Reset();
+    void Start(uint32 seed);
     void Render();
     bool MovePiece(int x, int y, int rotation);
     void NewPiece();
     void LandPiece();
     bool Explode();
     void ApplyUserInput(int & xMovement, int & rotation);
-    void Update(int deltaTimeMs);
-
-    static void CreateRandomPiece(Grid & newPiece, int numColours);
+    void Update(int deltaTimeMs, PlayerInput const & input);
+    void Step(int deltaTimeMs, PlayerInput const & input);
+    bool IsAnimating() const;
+    uint32 StateHash() const;
+    // 'snapshot' must have room for GameSnapshotSize() bytes for the current board.
+    // RestoreState returns false if the restored state doesn't hash to the one which was saved (e.g. a damaged file)
+    void SaveState(GameSnapshot* snapshot) const;
+    bool RestoreState(GameSnapshot const * snapshot);
+    bool SaveStateToFile(const char* filename) const;
+    bool RestoreStateFromFile(const char* filename);
+
+    void CreateRandomPiece(Grid & newPiece, int & type, int & colour);
+    static void BuildPiece(Grid & newPiece, int type, int colour);
 };
 
 #endif /* !_GAME_H */
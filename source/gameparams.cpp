@@ -0,0 +1,198 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "gameparams.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Level progression settings, from easy to hard.
+// Currently, the level 0 settings are never used (levels go 1,2,3,4,5,6,7,8,9)
+const GameParams g_DefaultGameParams =
+{
+    DEFAULT_GAME_WIDTH, DEFAULT_GAME_HEIGHT,
+    {400, 400, 290, 180, 300, 200, 120, 80,  60,  50,},    // gravity
+    {  5,   5,   5,   5,   6,   6,   6,   6,   6,   6,},    // colours
+    {   0,   30,  60,  90,  120, 150, 180, 210, 250, -1,},  // levelPieces
+    12,                 // explodeThreshold
+    10, 10,             // landingBase, landingSquare
+    300, 4, 100, 100,   // explosionBase, explosionStep, explosionLinear, explosionSquare
+    64,                 // maxMultiplier
+};
+
+struct ParamSetting
+{
+    const char* name;
+    int offset;     // Of the first value within GameParams
+    int count;
+};
+
+#define PARAM_SETTING(name, count) { #name, (int)offsetof(GameParams, name), count }
+
+static const ParamSetting s_Settings[] =
+{
+    PARAM_SETTING(width, 1),
+    PARAM_SETTING(height, 1),
+    PARAM_SETTING(gravity, NUM_LEVEL_ENTRIES),
+    PARAM_SETTING(colours, NUM_LEVEL_ENTRIES),
+    PARAM_SETTING(levelPieces, NUM_LEVEL_ENTRIES),
+    PARAM_SETTING(explodeThreshold, 1),
+    PARAM_SETTING(landingBase, 1),
+    PARAM_SETTING(landingSquare, 1),
+    PARAM_SETTING(explosionBase, 1),
+    PARAM_SETTING(explosionStep, 1),
+    PARAM_SETTING(explosionLinear, 1),
+    PARAM_SETTING(explosionSquare, 1),
+    PARAM_SETTING(maxMultiplier, 1),
+};
+
+#define NUM_PARAM_SETTINGS ((int)(sizeof(s_Settings) / sizeof(s_Settings[0])))
+
+// Check the values are ones the game can play with
+static bool Validate(GameParams const & params, char* error, int errorSize)
+{
+    if (params.width < MIN_GAME_SIZE || params.width > MAX_GAME_WIDTH || params.height < MIN_GAME_SIZE || params.height > MAX_GAME_HEIGHT)
+    {
+        snprintf(error, errorSize, "the board must be from %dx%d to %dx%d", MIN_GAME_SIZE, MIN_GAME_SIZE, MAX_GAME_WIDTH, MAX_GAME_HEIGHT);
+        return false;
+    }
+    for (int i=1; i<NUM_LEVEL_ENTRIES; i++)
+    {
+        if (params.gravity[i] < 1)
+        {
+            snprintf(error, errorSize, "gravity for level %d must be at least 1", i);
+            return false;
+        }
+        if (params.colours[i] < 1 || params.colours[i] > MAX_NUM_COLOURS)
+        {
+            snprintf(error, errorSize, "colours for level %d must be from 1 to %d", i, MAX_NUM_COLOURS);
+            return false;
+        }
+    }
+    if (params.explodeThreshold < 2 || params.explodeThreshold > params.width*params.height)
+    {
+        snprintf(error, errorSize, "explodeThreshold must be from 2 to %d", params.width*params.height);
+        return false;
+    }
+    if (params.explosionStep < 1)
+    {
+        snprintf(error, errorSize, "explosionStep must be at least 1");
+        return false;
+    }
+    if (params.maxMultiplier < 1)
+    {
+        snprintf(error, errorSize, "maxMultiplier must be at least 1");
+        return false;
+    }
+    return true;
+}
+
+bool GameParamsParse(GameParams & params, const char* text, char* error, int errorSize)
+{
+    GameParams result = params;
+    int lineNumber = 0;
+
+    while (*text)
+    {
+        // Copy out the next line, without any comment
+        char line[256];
+        int length = (int)strcspn(text, "\r\n");
+        lineNumber++;
+        if (length >= (int)sizeof(line))
+        {
+            snprintf(error, errorSize, "line %d is too long", lineNumber);
+            return false;
+        }
+        memcpy(line, text, length);
+        line[length] = 0;
+        text += length;
+        if (*text == '\r')
+            text++;
+        if (*text == '\n')
+            text++;
+
+        char* comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+
+        char* p = line + strspn(line, " \t");
+        if (!*p)
+            continue;
+
+        char name[32];
+        int nameLength = (int)strcspn(p, " \t");
+        if (nameLength >= (int)sizeof(name))
+            nameLength = sizeof(name) - 1;
+        memcpy(name, p, nameLength);
+        name[nameLength] = 0;
+        p += strcspn(p, " \t");
+
+        const ParamSetting* setting = NULL;
+        for (int i=0; i<NUM_PARAM_SETTINGS; i++)
+            if (!strcmp(s_Settings[i].name, name))
+                setting = &s_Settings[i];
+        if (!setting)
+        {
+            snprintf(error, errorSize, "line %d: unknown setting '%s'", lineNumber, name);
+            return false;
+        }
+
+        int32_t* values = (int32_t*)((char*)&result + setting->offset);
+        for (int i=0; i<setting->count; i++)
+        {
+            char* end;
+            long value = strtol(p, &end, 10);
+            if (end == p)
+            {
+                snprintf(error, errorSize, "line %d: %s needs %d value%s", lineNumber, name, setting->count, setting->count > 1 ? "s" : "");
+                return false;
+            }
+            values[i] = (int32_t)value;
+            p = end;
+        }
+
+        if (p[strspn(p, " \t")])
+        {
+            snprintf(error, errorSize, "line %d: too many values for %s", lineNumber, name);
+            return false;
+        }
+    }
+
+    if (!Validate(result, error, errorSize))
+        return false;
+
+    params = result;
+    return true;
+}
+
+uint32_t GameParamsHash(GameParams const & params)
+{
+    // FNV-1a over every value, setting by setting
+    uint32_t hash = 2166136261u;
+    for (int s=0; s<NUM_PARAM_SETTINGS; s++)
+    {
+        const int32_t* values = (const int32_t*)((const char*)&params + s_Settings[s].offset);
+        for (int i=0; i<s_Settings[s].count; i++)
+        {
+            uint32_t value = (uint32_t)values[i];
+            for (int b=0; b<4; b++)
+            {
+                hash ^= (value >> (b*8)) & 0xff;
+                hash *= 16777619u;
+            }
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,86 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _GAMEPARAMS_H
+#define _GAMEPARAMS_H
+
+#include "gamerules.h"
+
+// The tunable values of the game: the size of the board, level progression and scoring. Variants of the game (a wider
+// board, a lower explosion threshold, ...) are parameter files.
+// The game uses the defaults unless the ParamsFile setting names a parameter file, and the batch environment and the
+// tools/sweep harness can load different sets to compare them. This doesn't use the Marmalade SDK.
+//
+// A parameter file is text, one setting per line, with '#' starting a comment. Settings which aren't in the file keep
+// their default values:
+//   gravity 400 400 290 180 300 200 120 80 60 50
+//   explodeThreshold 12
+
+// Each level table has an entry for every level from 0 (which is never used; levels go from 1 to MAX_LEVEL)
+#define NUM_LEVEL_ENTRIES (MAX_LEVEL + 1)
+
+struct GameParams
+{
+    // Size of the playing area, from MIN_GAME_SIZE up to MAX_GAME_WIDTH by MAX_GAME_HEIGHT
+    int32_t width;                              // "width"
+    int32_t height;                             // "height"
+
+    // Gravity is the number of milliseconds before the piece is automatically moved down one square.
+    // Colours is the number of different colours used. This shouldn't decrease, else the player might be left with
+    // pieces they can't get rid of.
+    // Level pieces is the cumulative number of pieces played to reach the next level.
+    int32_t gravity[NUM_LEVEL_ENTRIES];         // "gravity"
+    int32_t colours[NUM_LEVEL_ENTRIES];         // "colours"
+    int32_t levelPieces[NUM_LEVEL_ENTRIES];     // "levelPieces"
+
+    int32_t explodeThreshold;       // "explodeThreshold": tiles in a group before it explodes
+
+    // Landing a piece scores landingBase + landingSquare * (new connections)^2
+    int32_t landingBase;            // "landingBase"
+    int32_t landingSquare;          // "landingSquare"
+
+    // Exploding a group scores explosionBase + explosionLinear * extra + explosionSquare * extra^2, where extra is
+    // the number of tiles over the threshold divided by explosionStep. This is multiplied by the chain multiplier,
+    // which doubles with every explosion up to maxMultiplier
+    int32_t explosionBase;          // "explosionBase"
+    int32_t explosionStep;          // "explosionStep"
+    int32_t explosionLinear;        // "explosionLinear"
+    int32_t explosionSquare;        // "explosionSquare"
+    int32_t maxMultiplier;          // "maxMultiplier"
+};
+
+extern const GameParams g_DefaultGameParams;
+
+// Read settings from the text of a parameter file into 'params', which should hold the defaults (or another set to
+// change). Returns false, with a description in 'error', if the text has a mistake or gives values the game can't use
+bool GameParamsParse(GameParams & params, const char* text, char* error, int errorSize);
+
+// Hash of every setting, for telling whether two sets of parameters are the same (e.g. the ones a recording was made
+// with, see recording.h). It only depends on the values, so it's the same on every platform
+uint32_t GameParamsHash(GameParams const & params);
+
+// Score for landing a piece. More points for pieces which fit together nicely (measured by the number of new
+// connections created)
+inline int LandingScore(GameParams const & params, int newConnections)
+{
+    return newConnections * newConnections * params.landingSquare + params.landingBase;
+}
+
+// Score for exploding a group of tiles, before the multiplier is applied. Extra points for blowing up larger groups
+inline int ExplosionScore(GameParams const & params, int numTiles)
+{
+    int extra = (numTiles - params.explodeThreshold) / params.explosionStep;
+    return params.explosionBase + extra * params.explosionLinear + extra * extra * params.explosionSquare;
+}
+
+#endif /* !_GAMEPARAMS_H */
@@ -0,0 +1,129 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _GAMERULES_H
+#define _GAMERULES_H
+
+#include <stdint.h>
+
+// Rules of the game, shared by the game itself and the batch environment (see batchenv.h). The values which are tuned
+// (level progression and scoring) are in gameparams.h.
+// This doesn't use the Marmalade SDK, so it can be built into host tools.
+
+// Default width and height of the playing area, and the largest the parameters can make it (see GameParams).
+// A row or column of the largest board fits in 32 bits, unless BLOCSLOT_MEGA_BOARD is defined: that allows boards up to
+// 128x256, for event play and for measuring how the board algorithms scale (see tools/gridbench.cpp)
+#define DEFAULT_GAME_WIDTH  10
+#define DEFAULT_GAME_HEIGHT 16
+#define MIN_GAME_SIZE       PIECE_SIZE
+#ifdef BLOCSLOT_MEGA_BOARD
+#define MAX_GAME_WIDTH      128
+#define MAX_GAME_HEIGHT     256
+#else
+#define MAX_GAME_WIDTH      16
+#define MAX_GAME_HEIGHT     24
+#endif
+#define MAX_GAME_CELLS      (MAX_GAME_WIDTH*MAX_GAME_HEIGHT)
+
+// Number of different colour tiles there are (one tile sheet each)
+#define MAX_NUM_COLOURS 6
+
+// Default number of adjacent tiles of the same colour needed before they explode (see GameParams)
+#define EXPLODE_THRESHOLD 12
+
+// Width and height of the grid holding a piece
+#define PIECE_SIZE 5
+
+// Number of different piece shapes
+#define NUM_PIECE_TYPES 7
+
+#define MAX_LEVEL       9
+
+// Bitfield used for remembering which directions from a tile contain a connected tile
+enum ConnectFlags
+{
+    CONNECT_UP    = 1<<0,
+    CONNECT_LEFT  = 1<<1,
+    CONNECT_DOWN  = 1<<2,
+    CONNECT_RIGHT = 1<<3,
+};
+
+// Shape of each type of piece: the tiles it covers within its PIECE_SIZE square (before rotation), and the number of
+// rotations it can be in (see Grid::Rotate)
+struct PieceShape
+{
+    int numRotations;
+    int8_t tiles[4][2];     // x, y
+};
+
+static const PieceShape pieceShapes[NUM_PIECE_TYPES] =
+{
+    { 1, {{1,1}, {1,2}, {2,1}, {2,2}} },    // 2x2 Square
+    { 2, {{0,2}, {1,2}, {2,2}, {3,2}} },    // 1x4 Long thin piece
+    { 2, {{1,1}, {2,1}, {2,2}, {3,2}} },    // 'Z' shaped piece
+    { 2, {{1,2}, {2,2}, {2,1}, {3,1}} },    // 'S' shaped piece
+    { 4, {{2,1}, {1,2}, {2,2}, {3,2}} },    // 'T' shaped piece
+    { 4, {{1,1}, {1,2}, {2,2}, {3,2}} },    // Backwards 'L' shaped piece
+    { 4, {{3,1}, {1,2}, {2,2}, {3,2}} },    // 'L' shaped piece
+};
+
+// Board dimensions for kernels which are compiled for particular sizes. FixedBoardSize lets the compiler unroll and
+// fold the loops for the common sizes, and RuntimeBoardSize handles any other size with the same code
+template <int W, int H> struct FixedBoardSize
+{
+    FixedBoardSize(int, int) {}
+    int Width() const { return W; }
+    int Height() const { return H; }
+    int Cells() const { return W*H; }
+};
+
+struct RuntimeBoardSize
+{
+    int width, height;
+
+    RuntimeBoardSize(int w, int h) : width(w), height(h) {}
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int Cells() const { return width*height; }
+};
+
+typedef FixedBoardSize<DEFAULT_GAME_WIDTH, DEFAULT_GAME_HEIGHT> DefaultBoardSize;
+
+// Random number generator owned by the game (xorshift), so that it's saved and restored along with the rest of the
+// simulation state
+struct GameRandom
+{
+    uint32_t state;
+
+    void Seed(uint32_t seed)
+    {
+        // Zero is the one state xorshift can't leave
+        state = seed ? seed : 0x9e3779b9;
+    }
+
+    uint32_t Next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Returns a number in the range [min, max)
+    int Range(int min, int max)
+    {
+        return min + (int)(Next() % (uint32_t)(max - min));
+    }
+};
+
+#endif /* !_GAMERULES_H */
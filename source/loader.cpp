@@ -0,0 +1,202 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "IwResManager.h"
+#include "s3eFile.h"
+#include "s3eThread.h"
+#include "s3eTimer.h"
+#include "loader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_LOADER_REQUESTS 8
+
+struct LoaderRequest
+{
+    char filename[32];
+    CIwResGroup** result;
+};
+
+// Groups waiting to be loaded, in order
+static LoaderRequest s_Queue[MAX_LOADER_REQUESTS];
+static int s_QueueSize = 0;
+
+// Prefetch of the group at the head of the queue
+static s3eThread* s_Worker = NULL;
+static char s_PrefetchFilename[32];
+static volatile bool s_PrefetchDone = false;
+
+static bool s_UsingTilesGroup = false;
+
+static uint32 s_StartTime = 0;
+static uint32 s_FirstFrameTime = 0;
+static bool s_ReportedInteractive = false;
+
+// Read a group's file from storage so it's cached when IwResManager loads it.
+// Release builds load the prebuilt .group.bin, resource building builds parse the .group itself
+static void* PrefetchFunc(void* userData)
+{
+    char filename[40];
+    sprintf(filename, "%s.bin", s_PrefetchFilename);
+    s3eFile* f = s3eFileOpen(filename, "rb");
+    if (!f)
+        f = s3eFileOpen(s_PrefetchFilename, "rb");
+
+    if (f)
+    {
+        static char buffer[32768];
+        while (s3eFileRead(buffer, 1, sizeof(buffer), f) == sizeof(buffer))
+            ;
+        s3eFileClose(f);
+    }
+
+    s_PrefetchDone = true;
+    return NULL;
+}
+
+// Wait for the worker to finish, if it's running
+static void JoinWorker()
+{
+    if (s_Worker)
+    {
+        s3eThreadJoin(s_Worker, NULL);
+        s_Worker = NULL;
+    }
+}
+
+// Start prefetching the group at the head of the queue, if it isn't being prefetched already
+static void StartPrefetch()
+{
+    if (!s_QueueSize || s_Worker || !s3eThreadAvailable())
+        return;
+
+    strcpy(s_PrefetchFilename, s_Queue[0].filename);
+    s_PrefetchDone = false;
+    s_Worker = s3eThreadCreate(PrefetchFunc, NULL, NULL);
+
+    // If the thread couldn't be started, the group is simply read when it's loaded
+    if (!s_Worker)
+        s_PrefetchDone = true;
+}
+
+// Load the group at the head of the queue on the main thread
+static void LoadNext()
+{
+    LoaderRequest request = s_Queue[0];
+    s_QueueSize--;
+    memmove(s_Queue, s_Queue + 1, s_QueueSize * sizeof(LoaderRequest));
+
+    // The worker may still be reading a group which has been cancelled
+    JoinWorker();
+
+    uint32 start = (uint32)s3eTimerGetMs();
+    *request.result = IwGetResManager()->LoadGroup(request.filename);
+    IwAssertMsg(APP, *request.result, ("Couldn't load %s", request.filename));
+    s3eDebugTracePrintf("Loader: %s took %dms on the main thread", request.filename, (uint32)s3eTimerGetMs() - start);
+}
+
+static void ReportInteractive()
+{
+    if (s_ReportedInteractive || s_QueueSize || !s_FirstFrameTime)
+        return;
+
+    s_ReportedInteractive = true;
+    s3eDebugTracePrintf("Startup: first frame after %dms, all resources loaded after %dms",
+        s_FirstFrameTime - s_StartTime, (uint32)s3eTimerGetMs() - s_StartTime);
+}
+
+void LoaderInit(uint32 startTimeMs)
+{
+    s_StartTime = startTimeMs;
+
+    // Resource building builds boot.group itself, otherwise it needs the binary
+    s_UsingTilesGroup = !s3eFileCheckExists("boot.group") && !s3eFileCheckExists("boot.group.bin") &&
+        s3eFileCheckExists("tiles.group.bin");
+    if (s_UsingTilesGroup)
+        s3eDebugTracePrintf("Resource binaries for the atlases haven't been built, using tiles.group.bin");
+
+    IwGetResManager()->LoadGroup(s_UsingTilesGroup ? "tiles.group" : "boot.group");
+}
+
+bool LoaderUsingTilesGroup()
+{
+    return s_UsingTilesGroup;
+}
+
+void LoaderTerminate()
+{
+    JoinWorker();
+    s_QueueSize = 0;
+}
+
+void LoaderQueueGroup(const char* filename, CIwResGroup** result)
+{
+    IwAssertMsg(APP, s_QueueSize < MAX_LOADER_REQUESTS, ("Too many resource groups queued"));
+    IwAssertMsg(APP, strlen(filename) < sizeof(s_Queue[0].filename), ("Resource group name too long (%s)", filename));
+
+    *result = NULL;
+    LoaderRequest& request = s_Queue[s_QueueSize++];
+    strcpy(request.filename, filename);
+    request.result = result;
+
+    StartPrefetch();
+}
+
+void LoaderCancel(CIwResGroup** result)
+{
+    int j = 0;
+    for (int i=0; i<s_QueueSize; i++)
+        if (s_Queue[i].result != result)
+            s_Queue[j++] = s_Queue[i];
+    s_QueueSize = j;
+}
+
+void LoaderUpdate()
+{
+    if (s_QueueSize)
+    {
+        // Don't hold up the frame waiting for the disk. Without threads, just load the group
+        bool ready = !s3eThreadAvailable() || (s_PrefetchDone && !strcmp(s_PrefetchFilename, s_Queue[0].filename));
+        if (ready)
+            LoadNext();
+        else if (s_PrefetchDone)
+        {
+            // The group being prefetched was cancelled
+            JoinWorker();
+        }
+
+        StartPrefetch();
+    }
+
+    ReportInteractive();
+}
+
+void LoaderFinish()
+{
+    while (s_QueueSize)
+        LoadNext();
+
+    ReportInteractive();
+}
+
+bool LoaderIsBusy()
+{
+    return s_QueueSize != 0;
+}
+
+void LoaderFirstFrame()
+{
+    if (!s_FirstFrameTime)
+        s_FirstFrameTime = (uint32)s3eTimerGetMs();
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _LOADER_H
+#define _LOADER_H
+
+#include "s3eTypes.h"
+
+// Background resource loading.
+// Only the boot group (the images used by the title screen) is loaded before the first frame. Other groups are queued
+// and loaded one per frame while the title screen is displayed.
+// Only the file I/O is moved off the main thread: a worker thread reads each group's file from storage ahead of time, so
+// the main thread doesn't wait on the disk. IwResManager isn't thread-safe, so LoadGroup still deserialises the group,
+// decodes its textures and uploads them on the main thread, and the frame after which a group loads is longer by that
+// much (the time each group takes is printed as a debug trace).
+
+class CIwResGroup;
+
+// Load the boot group. 'startTimeMs' is the time the application started, used to report startup times
+void LoaderInit(uint32 startTimeMs);
+
+// The boot, font and per tile size groups are built by the [artbuild] deployment. If their binaries haven't been deployed,
+// the prebuilt tiles group (which holds every image and font as a separate resource) is loaded by LoaderInit instead,
+// and this returns true
+bool LoaderUsingTilesGroup();
+void LoaderTerminate();
+
+// Queue a group to be loaded. '*result' is set on the main thread (during LoaderUpdate or LoaderFinish) once it has loaded
+void LoaderQueueGroup(const char* filename, CIwResGroup** result);
+
+// Remove any queued request which would set '*result'
+void LoaderCancel(CIwResGroup** result);
+
+// Load the next queued group, if it's ready. Called once per frame, after the frame has been presented
+void LoaderUpdate();
+
+// Load everything in the queue immediately
+void LoaderFinish();
+
+bool LoaderIsBusy();
+
+// Called after the first frame has been presented
+void LoaderFirstFrame();
+
+#endif /* !_LOADER_H */
@@ -24,6 +24,9 @@ enum LocalisationIDs
     ID_UNSUPPORTED_ORIENTATION,
 };
 
+// Longest string in any language, in bytes of UTF-8 (including the terminator)
+#define MAX_LOCALISED_STRING 96
+
 extern const char ** g_Localisation;
 
 #endif /* !_LOCALISE_H */
@@ -14,6 +14,7 @@
 #include "s3eKeyboard.h"
 #include "s3ePointer.h"
 #include "s3eDevice.h"
+#include "s3eFile.h"
 #include <time.h>
 
 #include "Iw2D.h"
@@ -24,6 +25,11 @@
 #include "localise.h"
 #include "effects.h"
 #include "titlescreen.h"
+#include "loader.h"
+#include "framescheduler.h"
+#include "profile.h"
+#include "trace.h"
+#include "recording.h"
 
 #include "SkillzSDK.h"
 
@@ -56,6 +62,27 @@ int32 ScoreReported(void* systemData, void* appData)
     return S3E_RESULT_SUCCESS;
 }
 
+// A game in progress is saved here when the application is paused, in case the OS closes the application while it's in
+// the background. The file is deleted when the application carries on instead
+#define SUSPEND_FILE "suspend.snapshot"
+
+// Callback from S3E when the application is sent to the background
+int32 PauseCallback(void* systemData, void* userData)
+{
+    PuzzleGame* game = (PuzzleGame*)userData;
+    if (g_GameMode == MODE_GAMEPLAY && game->mode != PuzzleState::MODE_GAME_OVER)
+        game->SaveStateToFile(SUSPEND_FILE);
+    return 0;
+}
+
+// Callback from S3E when the application returns to the foreground
+int32 UnpauseCallback(void* systemData, void* userData)
+{
+    if (s3eFileCheckExists(SUSPEND_FILE))
+        s3eFileDelete(SUSPEND_FILE);
+    return 0;
+}
+
 // Flag indicating whether the screen size or rotation has changed since the last call to SetupImages
 bool g_ScreenSizeChanged = true;
 
@@ -71,16 +98,16 @@ int32 ScreenSizeChangeCallback(void* systemData, void* userData)
 }
 
 // Recalculate tile size when the screen size or rotation changes
-// Calls 'SetupImages' to update the global pointers to materials.
-// Also determines the size of the font to use
-void UpdateScreenSize()
+// Calls 'SetupImages' to load the tiles for the new size (the font to use also depends on it).
+// Returns true if it did, as that can take a while
+bool UpdateScreenSize()
 {
     if (g_ScreenSizeChanged)
     {
         g_ScreenSizeChanged = false;
 
-        int x = Iw2DGetSurfaceWidth() / GAME_WIDTH;
-        int y = Iw2DGetSurfaceHeight() / GAME_HEIGHT;
+        int x = Iw2DGetSurfaceWidth() / g_GameParams.width;
+        int y = Iw2DGetSurfaceHeight() / g_GameParams.height;
         int tempSize = MIN(x, y);
 
         g_ScreenTooSmall = (tempSize<12);
@@ -100,19 +127,12 @@ void UpdateScreenSize()
         {
             g_TileSize = tempSize;
 
-            // Look up materials by name
+            // Load the tiles for this size in the background
             SetupImages(g_TileSize);
-
-            // Choose font based on tile size
-            if (g_TileSize <= 16)
-                font = Iw2DCreateFontResource("font_small");
-            else
-                font = Iw2DCreateFontResource("font");
-
-            //Set this font as the current one
-            Iw2DSetFont(font);
+            return true;
         }
     }
+    return false;
 }
 
 // Draw the screen informing the user that the current orientation isn't supported
@@ -125,9 +145,9 @@ void DrawUnsupportedScreen()
     DrawBlackBG(0, 0, displayWidth, displayHeight);
 
     // Draw message (centered, and automatically word wrapped)
-    Iw2DDrawString(g_Localisation[ID_UNSUPPORTED_ORIENTATION],
-        CIwSVec2(0,0),
-        CIwSVec2((int16)displayWidth, (int16)displayHeight),
+    RenderDrawString(g_Localisation[ID_UNSUPPORTED_ORIENTATION],
+        0, 0,
+        displayWidth, displayHeight,
         IW_2D_FONT_ALIGN_CENTRE, IW_2D_FONT_ALIGN_CENTRE);
 }
 
@@ -140,6 +160,8 @@ void DrawUnsupportedScreen()
 // loop exits, application data is deleted and modules are terminated before exiting.
 int main(int argc, char* argv[])
 {
+    uint32 startTime = (uint32)s3eTimerGetMs();
+
     // Initialisation of Studio modules
     Iw2DInit();         // Initialise support for rendering with the standard SW renderer
 
@@ -147,9 +169,14 @@ int main(int argc, char* argv[])
     s3eSurfaceSetInt(S3E_SURFACE_DEVICE_ORIENTATION_LOCK, S3E_SURFACE_PORTRAIT);
 
     IwResManagerInit();
+    TraceInit();
+
+    // Load just what's needed for the title screen. Everything else is loaded in the background once it's displayed
+    LoaderInit(startTime);
+    SetupBootImages();
 
-    // Load all application data
-    IwGetResManager()->LoadGroup("tiles.group");
+    // The tile size depends on the size of the board
+    LoadGameParams();
 
     // Setup materials based on screen size
     UpdateScreenSize();
@@ -159,30 +186,52 @@ int main(int argc, char* argv[])
 
     g_EffectsManager = new EffectManager; // Manager for graphical effects
 
+    // Record games, and check an earlier recording, if the settings ask for it
+    RecordingInit();
+
     PuzzleGame * game = new PuzzleGame;
     TitleScreen * title = new TitleScreen;
 
+    // Carry on with the game which was in progress if the OS closed the application while it was paused
+    if (s3eFileCheckExists(SUSPEND_FILE))
+    {
+        if (game->RestoreStateFromFile(SUSPEND_FILE))
+            g_GameMode = MODE_GAMEPLAY;
+        s3eFileDelete(SUSPEND_FILE);
+    }
+    s3eDeviceRegister(S3E_DEVICE_PAUSE, PauseCallback, game);
+    s3eDeviceRegister(S3E_DEVICE_UNPAUSE, UnpauseCallback, NULL);
+
     // Register needed Skillz callbacks
     SkillzSDKRegister(SKILLZSDK_CALLBACK_SKILLZ_DID_LAUNCH, SkillzDidFinishLaunching, title);
     SkillzSDKRegister(SKILLZSDK_CALLBACK_TOURNAMENT_WILL_START_WITH_MATCH_DATA, TournamentWillStart, game);
     SkillzSDKRegister(SKILLZSDK_CALLBACK_REPORT_SCORE_HAS_COMPLETED, ScoreReported, NULL);
     SkillzSDKRegister(SKILLZSDK_CALLBACK_SKILLZ_WILL_EXIT, SkillzWillExit, title);
 
+    FrameScheduler scheduler;
     uint32 timer = (uint32)s3eTimerGetMs();
-
-    // Initialize game based on game id given by the Skillz Developer Portal
-    SkillzInit("934", S3eSkillzSandbox);
+    bool firstFrame = true;
+    bool animating = true;
 
     while (1)
     {
-        s3eDeviceYield(0);
+        // Write out the previous frame's trace events while there's time to spare
+        TraceFlush();
+
+        // Wait until the next frame is due. This runs at a lower rate when nothing is moving
+        scheduler.WaitForNextFrame(animating);
+        uint64 frameStartUs = s3eTimerGetUSTNanoseconds() / 1000;
+
+        // The previous frame has finished, so record its timings
+        ProfileEndFrame();
+        PROFILE_SCOPE(PROFILE_FRAME);
 
         // Check for user quit
         if (s3eDeviceCheckQuitRequest())
             break;
 
-        // Check for screen resizing/rotation
-        UpdateScreenSize();
+        // Check for screen resizing/rotation. Frames which load resources aren't used to choose the effect quality
+        bool loadedResources = UpdateScreenSize();
 
         // Calculate the amount of time that's passed since last frame
         int delta = uint32(s3eTimerGetMs()) - timer;
@@ -194,17 +243,37 @@ int main(int argc, char* argv[])
         if (delta > 100)
             delta = 100;
 
-        UpdateInput(delta);
+        {
+            PROFILE_SCOPE(PROFILE_INPUT);
+            UpdateInput();
+        }
+
+        // Gameplay can't start until everything has loaded, so finish loading now if we're still waiting
+        if (g_GameMode == MODE_GAMEPLAY && !ImagesReady())
+        {
+            LoaderFinish();
+            UpdateImages();
+            loadedResources = true;
+        }
 
         // Update and render
         if (g_ScreenTooSmall)
         {
             DrawUnsupportedScreen();
+            animating = false;
         }
         else if (g_GameMode == MODE_TITLE)
         {
-            title->Update(delta);
-            title->Render();
+            {
+                PROFILE_SCOPE(PROFILE_UPDATE);
+                title->Update(delta);
+            }
+            {
+                PROFILE_SCOPE(PROFILE_RENDER);
+                title->Render();
+            }
+
+            animating = title->IsAnimating();
 
             // When starting a new game, make sure we reset the state
             if (g_GameMode == MODE_GAMEPLAY)
@@ -212,16 +281,59 @@ int main(int argc, char* argv[])
         }
         else
         {
-            game->Update(delta);
-            game->Render();
+            {
+                PROFILE_SCOPE(PROFILE_UPDATE);
+                game->Update(delta, g_PlayerInput);
+            }
+            {
+                PROFILE_SCOPE(PROFILE_RENDER);
+                game->Render();
+            }
+            animating = game->IsAnimating();
         }
 
+        ProfileRenderOverlay();
+
+        // Submit the draws recorded this frame
+        {
+            PROFILE_SCOPE(PROFILE_FLUSH);
+            RenderFlush();
+        }
+
+        // Choose the effect quality for the next frames from the time this one's work took. Waiting for the display
+        // isn't counted, since it only shows how far ahead of the deadline the frame was. Nor are frames which loaded
+        // resources (like LoaderUpdate below), as a one-off load would otherwise drop the quality for seconds
+        if (!loadedResources)
+            g_EffectsManager->UpdateQuality((int)(s3eTimerGetUSTNanoseconds() / 1000 - frameStartUs),
+                scheduler.GetFrameBudgetMs() * 1000);
+
         //Present the rendered surface to the screen
-        Iw2DSurfaceShow();
+        {
+            PROFILE_SCOPE(PROFILE_SHOW);
+            Iw2DSurfaceShow();
+        }
+
+        if (firstFrame)
+        {
+            firstFrame = false;
+            LoaderFirstFrame();
+
+            // Initialize game based on game id given by the Skillz Developer Portal.
+            // This is done once the title screen is visible, so that it doesn't delay the first frame
+            SkillzInit("934", S3eSkillzSandbox);
+        }
+
+        // Load the next resource group, if any are waiting. Loading runs at the full frame rate
+        LoaderUpdate();
+        UpdateImages();
+        if (LoaderIsBusy())
+            animating = true;
     }
 
     // Delete objects and terminate systems
     s3eSurfaceUnRegister(S3E_SURFACE_SCREENSIZE, ScreenSizeChangeCallback);
+    s3eDeviceUnRegister(S3E_DEVICE_PAUSE, PauseCallback);
+    s3eDeviceUnRegister(S3E_DEVICE_UNPAUSE, UnpauseCallback);
 
     delete game;
     delete title;
@@ -229,7 +341,10 @@ int main(int argc, char* argv[])
     // Delete any left-over effects
     delete g_EffectsManager;
 
+    RecordingTerminate();
+    LoaderTerminate();
     CleanupImages();
+    TraceTerminate();
 
     // Terminate system modules
     IwResManagerTerminate();
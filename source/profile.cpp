@@ -0,0 +1,192 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "profile.h"
+#include "allocstats.h"
+
+#ifdef IW_DEBUG
+
+#include "Iw2D.h"
+#include "s3eKeyboard.h"
+#include "s3eTimer.h"
+#include "rendering.h"
+#include "trace.h"
+#include "effects.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Recalculate the percentiles shown by the overlay every this many frames
+#define PROFILE_STATS_INTERVAL 30
+
+static const char* s_PhaseNames[NUM_PROFILE_PHASES] =
+{
+    "frame",
+    "input",
+    "update",
+    " effects",
+    " explode",
+    " fall",
+    " move",
+    "render",
+    " background",
+    " board",
+    " effects",
+    " text",
+    " buttons",
+    "flush",
+    "show",
+};
+
+// Time spent in each phase this frame, in microseconds
+static uint32 s_Current[NUM_PROFILE_PHASES];
+
+// Rolling window of per-frame times
+static uint32 s_Samples[NUM_PROFILE_PHASES][PROFILE_WINDOW];
+static int s_NumSamples = 0;
+static int s_NextSample = 0;
+
+// Percentiles shown by the overlay (p50, p95, p99)
+static uint32 s_Stats[NUM_PROFILE_PHASES][3];
+static int s_FramesUntilStats = 0;
+
+// Allocations per phase, summed since the percentiles were last calculated, and their average per frame
+static uint32 s_AllocSums[NUM_PROFILE_PHASES + 1];
+static int s_AllocFrames = 0;
+static float s_AllocStats[NUM_PROFILE_PHASES + 1];
+
+static int s_ActivePhase = -1;
+
+static bool s_ShowOverlay = false;
+
+ProfileScope::ProfileScope(int _phase)
+{
+    phase = _phase;
+    parent = s_ActivePhase;
+    s_ActivePhase = phase;
+    start = s3eTimerGetUSTNanoseconds();
+    TraceBeginPhase(phase);
+}
+
+ProfileScope::~ProfileScope()
+{
+    s_Current[phase] += (uint32)((s3eTimerGetUSTNanoseconds() - start) / 1000);
+    TraceEndPhase(phase);
+    s_ActivePhase = parent;
+}
+
+const char* ProfileGetPhaseName(int phase)
+{
+    // Sub-phases are indented for the overlay
+    const char* name = s_PhaseNames[phase];
+    while (*name == ' ')
+        name++;
+    return name;
+}
+
+int ProfileGetActivePhase()
+{
+    return s_ActivePhase;
+}
+
+static void CalculateStats()
+{
+    uint32 sorted[PROFILE_WINDOW];
+    for (int p=0; p<NUM_PROFILE_PHASES; p++)
+    {
+        // Insertion sort; the window is small
+        for (int i=0; i<s_NumSamples; i++)
+        {
+            uint32 v = s_Samples[p][i];
+            int j = i;
+            for (; j>0 && sorted[j-1] > v; j--)
+                sorted[j] = sorted[j-1];
+            sorted[j] = v;
+        }
+
+        s_Stats[p][0] = sorted[(s_NumSamples - 1) * 50 / 100];
+        s_Stats[p][1] = sorted[(s_NumSamples - 1) * 95 / 100];
+        s_Stats[p][2] = sorted[(s_NumSamples - 1) * 99 / 100];
+    }
+
+    for (int p=0; p<=NUM_PROFILE_PHASES; p++)
+        s_AllocStats[p] = s_AllocFrames ? (float)s_AllocSums[p] / s_AllocFrames : 0.0f;
+    memset(s_AllocSums, 0, sizeof(s_AllocSums));
+    s_AllocFrames = 0;
+}
+
+void ProfileEndFrame()
+{
+    for (int p=0; p<NUM_PROFILE_PHASES; p++)
+        s_Samples[p][s_NextSample] = s_Current[p];
+    memset(s_Current, 0, sizeof(s_Current));
+
+    s_NextSample = (s_NextSample + 1) % PROFILE_WINDOW;
+    if (s_NumSamples < PROFILE_WINDOW)
+        s_NumSamples++;
+
+    AllocEndFrame();
+    for (int p=0; p<=NUM_PROFILE_PHASES; p++)
+        s_AllocSums[p] += AllocGetFrameCounts(p).count;
+    s_AllocFrames++;
+
+    if (s3eKeyboardGetState(s3eKeyM) & S3E_KEY_STATE_PRESSED)
+        AllocReportCallSites();
+
+    if (s3eKeyboardGetState(s3eKeyP) & S3E_KEY_STATE_PRESSED)
+    {
+        s_ShowOverlay = !s_ShowOverlay;
+        s_FramesUntilStats = 0;
+    }
+
+    if (s_ShowOverlay && --s_FramesUntilStats <= 0)
+    {
+        s_FramesUntilStats = PROFILE_STATS_INTERVAL;
+        CalculateStats();
+    }
+}
+
+void ProfileRenderOverlay()
+{
+    if (!s_ShowOverlay || !s_NumSamples)
+        return;
+
+    // One line per phase, in milliseconds, with the average number of allocations per frame
+    char text[896];
+    int len = snprintf(text, sizeof(text), "ms          p50   p95   p99 allocs\n");
+    for (int p=0; p<NUM_PROFILE_PHASES && len < (int)sizeof(text); p++)
+    {
+        len += snprintf(text + len, sizeof(text) - len, "%-11s %5.2f %5.2f %5.2f %6.1f\n", s_PhaseNames[p],
+            s_Stats[p][0] / 1000.0f, s_Stats[p][1] / 1000.0f, s_Stats[p][2] / 1000.0f, s_AllocStats[p]);
+    }
+    if (len < (int)sizeof(text))
+    {
+        len += snprintf(text + len, sizeof(text) - len, "other allocs %.1f, live %uk, peak %uk\n",
+            s_AllocStats[ALLOC_NO_PHASE], AllocGetLiveBytes() / 1024, AllocGetFramePeakBytes() / 1024);
+    }
+    if (len < (int)sizeof(text))
+    {
+        EffectGovernor const & governor = g_EffectsManager->governor;
+        len += snprintf(text + len, sizeof(text) - len, "effects %s (%s), work %.2fms\n", EffectQualityName(governor.quality),
+            governor.automatic ? "auto" : "fixed", governor.smoothedUs / 1000.0f);
+    }
+
+    int displayWidth = Iw2DGetSurfaceWidth();
+    int displayHeight = Iw2DGetSurfaceHeight();
+
+    RenderSetOrigin(0, 0);
+    DrawBlackBG(0, displayHeight/4, displayWidth, displayHeight*3/4);
+    RenderDrawString(text, 0, displayHeight/4, displayWidth, displayHeight*3/4, IW_2D_FONT_ALIGN_LEFT, IW_2D_FONT_ALIGN_TOP);
+}
+
+#endif // IW_DEBUG
@@ -0,0 +1,84 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "s3eTypes.h"
+
+// Frame phase timing.
+// PROFILE_SCOPE times the rest of the enclosing block and adds it to the phase's total for the frame. Phases can nest, in
+// which case the outer phase includes the inner one. The last PROFILE_WINDOW frames of each phase are kept, and their
+// 50th/95th/99th percentiles are shown by an overlay which is toggled with the P key, along with the number of heap
+// allocations made in each phase (see allocstats.h).
+// This is only compiled into debug builds; in release builds the macros and functions do nothing.
+
+enum ProfilePhase
+{
+    PROFILE_FRAME,
+    PROFILE_INPUT,
+    PROFILE_UPDATE,
+    PROFILE_UPDATE_EFFECTS,
+    PROFILE_UPDATE_EXPLODE,
+    PROFILE_UPDATE_FALL,
+    PROFILE_UPDATE_MOVE,
+    PROFILE_RENDER,
+    PROFILE_RENDER_BACKGROUND,
+    PROFILE_RENDER_BOARD,
+    PROFILE_RENDER_EFFECTS,
+    PROFILE_RENDER_TEXT,
+    PROFILE_RENDER_BUTTONS,
+    PROFILE_FLUSH,
+    PROFILE_SHOW,
+    NUM_PROFILE_PHASES,
+};
+
+#define PROFILE_WINDOW 128
+
+#ifdef IW_DEBUG
+
+struct ProfileScope
+{
+    int phase;
+    int parent;     // Phase which was active when this scope started
+    uint64 start;
+
+    ProfileScope(int _phase);
+    ~ProfileScope();
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(phase)
+
+// Called once per frame, after the previous frame has finished. Also checks the key which toggles the overlay
+void ProfileEndFrame();
+
+// Draw the overlay, if it's enabled
+void ProfileRenderOverlay();
+
+const char* ProfileGetPhaseName(int phase);
+
+// Innermost phase currently being timed, or -1 outside of any PROFILE_SCOPE
+int ProfileGetActivePhase();
+
+#else
+
+#define PROFILE_SCOPE(phase)
+
+inline void ProfileEndFrame() {}
+inline void ProfileRenderOverlay() {}
+
+#endif
+
+#endif /* !_PROFILE_H */
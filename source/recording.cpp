@@ -0,0 +1,194 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "recording.h"
+#include "game.h"
+#include "effects.h"
+#include "s3eConfig.h"
+#include "s3eDebug.h"
+#include "s3eFile.h"
+
+// Entries are written in batches
+#define RECORDING_BUFFER_SIZE 256
+
+static s3eFile* s_RecordFile = NULL;
+static bool s_TickHashes = false;
+static RecordingEntry s_Buffer[RECORDING_BUFFER_SIZE];
+static int s_BufferUsed = 0;
+
+// Set while verifying, so the games being replayed aren't recorded
+static bool s_Verifying = false;
+
+static const char* s_StepNames[] =
+{
+    "moving the piece",     // MODE_ACTIVE_PIECE
+    "MakeFall",             // MODE_FALLING
+    "Explode",              // MODE_EXPLODING
+    "game over",            // MODE_GAME_OVER
+};
+
+static void FlushBuffer()
+{
+    if (s_RecordFile && s_BufferUsed)
+        s3eFileWrite(s_Buffer, sizeof(RecordingEntry), s_BufferUsed, s_RecordFile);
+    s_BufferUsed = 0;
+}
+
+static void AddEntry(RecordingEntry const & entry)
+{
+    if (!s_RecordFile || s_Verifying)
+        return;
+
+    s_Buffer[s_BufferUsed++] = entry;
+    if (s_BufferUsed == RECORDING_BUFFER_SIZE)
+        FlushBuffer();
+}
+
+void RecordingInit()
+{
+    char filename[S3E_CONFIG_STRING_MAX] = {0};
+    if (s3eConfigGetString("Blocslot", "VerifyFile", filename) == S3E_RESULT_SUCCESS && filename[0])
+        RecordingVerify(filename);
+
+    filename[0] = 0;
+    if (s3eConfigGetString("Blocslot", "RecordFile", filename) != S3E_RESULT_SUCCESS || !filename[0])
+        return;
+
+    int tickHashes = 0;
+    s3eConfigGetInt("Blocslot", "RecordTickHashes", &tickHashes);
+    s_TickHashes = tickHashes != 0;
+
+    s_RecordFile = s3eFileOpen(filename, "wb");
+    if (s_RecordFile)
+    {
+        RecordingHeader header = { RECORDING_MAGIC, RECORDING_VERSION, (uint32)(s_TickHashes ? RECORDING_TICK_HASHES : 0),
+            GameParamsHash(g_GameParams), g_GameParams.width, g_GameParams.height };
+        s3eFileWrite(&header, sizeof(header), 1, s_RecordFile);
+    }
+}
+
+void RecordingTerminate()
+{
+    if (s_RecordFile)
+    {
+        FlushBuffer();
+        s3eFileClose(s_RecordFile);
+        s_RecordFile = NULL;
+    }
+}
+
+void RecordingStartGame(uint32 seed)
+{
+    RecordingEntry entry = { RECORDING_START, 0, 0, 0, 0, seed };
+    AddEntry(entry);
+
+    // Make sure finished games are on disk
+    FlushBuffer();
+}
+
+void RecordingTick(int deltaMs, PlayerInput const & input, PuzzleGame const & game)
+{
+    if (!s_RecordFile)
+        return;
+
+    RecordingEntry entry;
+    entry.type = RECORDING_TICK;
+    entry.xMovement = (int8)input.xMovement;
+    entry.rotation = (int8)input.rotation;
+    entry.down = (int8)input.down;
+    entry.deltaMs = deltaMs;
+    entry.value = s_TickHashes ? game.StateHash() : game.checkHash;
+    AddEntry(entry);
+}
+
+bool RecordingVerify(const char* filename)
+{
+    s3eFile* f = s3eFileOpen(filename, "rb");
+    if (!f)
+    {
+        s3eDebugTracePrintf("Verify: couldn't open %s", filename);
+        return false;
+    }
+
+    RecordingHeader header;
+    if (s3eFileRead(&header, sizeof(header), 1, f) != 1 || header.magic != RECORDING_MAGIC || header.version != RECORDING_VERSION)
+    {
+        s3eDebugTracePrintf("Verify: %s is not a recording (or is from a different version)", filename);
+        s3eFileClose(f);
+        return false;
+    }
+
+    // The games can only be replayed with the parameters they were played with
+    uint32 paramsHash = GameParamsHash(g_GameParams);
+    if (header.paramsHash != paramsHash || header.boardWidth != g_GameParams.width || header.boardHeight != g_GameParams.height)
+    {
+        s3eDebugTracePrintf("Verify: %s was recorded with different game parameters (%dx%d board, hash %08x) from the ones "
+            "in use (%dx%d board, hash %08x). Set ParamsFile to the file it was recorded with",
+            filename, header.boardWidth, header.boardHeight, header.paramsHash, g_GameParams.width, g_GameParams.height, paramsHash);
+        s3eFileClose(f);
+        return false;
+    }
+    bool tickHashes = (header.flags & RECORDING_TICK_HASHES) != 0;
+
+    s_Verifying = true;
+    PuzzleGame* game = NULL;
+    int numGames = 0;
+    int tick = 0;
+    bool ok = true;
+
+    RecordingEntry entry;
+    while (s3eFileRead(&entry, sizeof(entry), 1, f) == 1)
+    {
+        if (entry.type == RECORDING_START)
+        {
+            if (!game)
+                game = new PuzzleGame;
+            game->Start(entry.value);
+            numGames++;
+            tick = 0;
+            continue;
+        }
+
+        if (!game)
+        {
+            s3eDebugTracePrintf("Verify: %s doesn't start with a game", filename);
+            ok = false;
+            break;
+        }
+
+        PlayerInput input = { entry.xMovement, entry.rotation, entry.down };
+        int mode = game->mode;
+        game->Step(entry.deltaMs, input);
+
+        uint32 hash = tickHashes ? game->StateHash() : game->checkHash;
+        if (hash != entry.value)
+        {
+            // Without per-update hashes, the difference is only seen when the next piece is created
+            s3eDebugTracePrintf("Verify: game %d differs %s update %d (input %d,%d,%d, %dms, during %s): expected %08x, got %08x",
+                numGames, tickHashes ? "at" : "by", tick, input.xMovement, input.rotation, input.down, entry.deltaMs,
+                s_StepNames[mode], entry.value, hash);
+            ok = false;
+            break;
+        }
+        tick++;
+    }
+
+    if (ok)
+        s3eDebugTracePrintf("Verify: %d games in %s match", numGames, filename);
+
+    delete game;
+    g_EffectsManager->Clear();
+    s_Verifying = false;
+    s3eFileClose(f);
+    return ok;
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _RECORDING_H
+#define _RECORDING_H
+
+#include "s3eTypes.h"
+
+// Game recordings, for checking a game by simulating it again.
+// If RecordFile is set in the [Blocslot] section of app.icf, the seed of every game and the input for every update are
+// written to that file, along with a hash of the game state after each update. By default this is the rolling hash
+// which is updated once per piece (PuzzleState::checkHash); with RecordTickHashes=1 the full state is hashed after every
+// update instead, so a replay which goes wrong can be pinned down to the exact update.
+// If VerifyFile is set, that recording is replayed when the application starts, and the first update whose hash
+// doesn't match is reported along with its input and what the simulation was doing.
+// The header records the board size and a hash of the game parameters (see gameparams.h), and a recording is only
+// replayed with the same parameters.
+
+struct PlayerInput;
+struct PuzzleGame;
+
+#define RECORDING_MAGIC     0x50525342  // "BSRP"
+#define RECORDING_VERSION   2
+
+// Flags in the file header
+#define RECORDING_TICK_HASHES   1   // Each update's hash is StateHash() rather than checkHash
+
+enum RecordingEntryType
+{
+    RECORDING_START,    // A game started
+    RECORDING_TICK,     // The game was updated
+};
+
+// The file is a RecordingHeader followed by any number of RecordingEntries
+struct RecordingHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint32 flags;
+    uint32 paramsHash;  // GameParamsHash of the parameters the games were played with
+    int32 boardWidth;   // Size of the board they were played on
+    int32 boardHeight;
+};
+
+struct RecordingEntry
+{
+    uint8 type;         // RecordingEntryType
+    int8 xMovement;     // PlayerInput for the update
+    int8 rotation;
+    int8 down;
+    uint32 deltaMs;     // Time step of the update
+    uint32 value;       // Seed for RECORDING_START, state hash after the update for RECORDING_TICK
+};
+
+// Open the recording file and verify the previous recording, as the settings ask. g_EffectsManager must exist
+void RecordingInit();
+void RecordingTerminate();
+
+void RecordingStartGame(uint32 seed);
+
+// Called after each PuzzleGame::Step
+void RecordingTick(int deltaMs, PlayerInput const & input, PuzzleGame const & game);
+
+// Replay a recording, returning false (and reporting where) if it doesn't match
+bool RecordingVerify(const char* filename);
+
+#endif /* !_RECORDING_H */
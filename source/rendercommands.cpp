@@ -0,0 +1,161 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "rendercommands.h"
+#include "atlasregions.h"
+
+#include <stdio.h>
+#include <string.h>
+
+RenderCommand* RenderCommandBuffer::Add()
+{
+    if (numCommands >= MAX_RENDER_COMMANDS)
+        return NULL;
+
+    return &commands[numCommands++];
+}
+
+int RenderCommandBuffer::AddString(const char* text)
+{
+    int len = (int)strlen(text) + 1;
+    if (stringsUsed + len > RENDER_STRING_POOL_SIZE)
+        return -1;
+
+    int offset = stringsUsed;
+    memcpy(strings + offset, text, len);
+    stringsUsed += len;
+    return offset;
+}
+
+void RenderCommandBuffer::GetStats(RenderStats& stats) const
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.numCommands = numCommands;
+
+    int lastImage = -1;
+    uint32_t lastColour = 0xffffffff;
+    int lastAlphaMode = RENDER_ALPHA_NONE;
+
+    for (int i=0; i<numCommands; i++)
+    {
+        RenderCommand const & c = commands[i];
+
+        if (c.colour != lastColour || c.alphaMode != lastAlphaMode)
+        {
+            stats.numStateChanges++;
+            lastColour = c.colour;
+            lastAlphaMode = c.alphaMode;
+        }
+
+        switch (c.type)
+        {
+        case RENDER_CMD_IMAGE:
+            stats.numImages++;
+            if (c.image != lastImage)
+            {
+                stats.numImageChanges++;
+                lastImage = c.image;
+            }
+            stats.pixelsFilled += c.dstW * c.dstH;
+            break;
+        case RENDER_CMD_RECT:
+            stats.numRects++;
+            stats.pixelsFilled += c.dstW * c.dstH;
+            break;
+        case RENDER_CMD_TILES:
+            stats.numImages++;
+            stats.numTiles += c.srcY;
+            if (c.image != lastImage)
+            {
+                stats.numImageChanges++;
+                lastImage = c.image;
+            }
+            stats.pixelsFilled += c.srcY * c.dstW * c.dstH;
+            break;
+        case RENDER_CMD_LAYER:
+            stats.numImages++;
+            stats.numImageChanges++;
+            lastImage = -1;
+            stats.pixelsFilled += c.dstW * c.dstH;
+            break;
+        case RENDER_CMD_STRING:
+            stats.numStrings++;
+            // The font is a texture too
+            lastImage = -1;
+            break;
+        }
+    }
+}
+
+void RenderGetImageName(int texture, int tileSize, char* name)
+{
+    static const char* textureNames[] =
+    {
+        "background",
+        "logo",
+        "play",
+        NULL,
+        "star",
+    };
+    static const char* colourNames[] =
+    {
+        "",
+        "green",
+        "red",
+        "lt_blue",
+        "purple",
+        "yellow",
+    };
+    static const char* buttonNames[] =
+    {
+        "touchscreenRotL",
+        "touchscreenRotR",
+        "touchscreenMoveL",
+        "touchscreenMoveDown",
+        "touchscreenMoveR",
+    };
+
+    if (texture == IMAGE_ATLAS)
+        sprintf(name, "atlas%d", tileSize);
+    else if (texture >= IMAGE_TOUCHSCREEN_BUTTONS)
+        strcpy(name, buttonNames[texture - IMAGE_TOUCHSCREEN_BUTTONS]);
+    else if (texture >= IMAGE_TILES)
+        sprintf(name, "tiles%d#%s", tileSize, colourNames[texture - IMAGE_TILES]);
+    else
+        strcpy(name, textureNames[texture]);
+}
+
+void RenderGetImagePath(int texture, int tileSize, char* path)
+{
+    char name[32];
+    RenderGetImageName(texture, tileSize, name);
+
+    if (texture == IMAGE_ATLAS)
+        sprintf(path, "textures/atlas/%s.tga", name);
+    else if (texture >= IMAGE_TILES && texture < IMAGE_TOUCHSCREEN_BUTTONS)
+        sprintf(path, "textures/tiles%d/%s.bmp", tileSize, name);
+    else
+        sprintf(path, "textures/%s.bmp", name);
+}
+
+const RenderAtlasRegion* RenderGetAtlasRegion(int image, int tileSize)
+{
+    if (image < IMAGE_STAR || image - IMAGE_STAR >= NUM_ATLAS_REGIONS)
+        return NULL;
+
+    for (int i=0; i<NUM_ATLAS_SIZES; i++)
+        if (g_AtlasTileSizes[i] == tileSize)
+            return &g_AtlasRegions[i][image - IMAGE_STAR];
+
+    return NULL;
+}
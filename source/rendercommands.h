@@ -0,0 +1,175 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _RENDERCOMMANDS_H
+#define _RENDERCOMMANDS_H
+
+// Render command buffer.
+// The rendering functions record every draw into a compact buffer which is replayed by a backend at the end of the frame:
+// Iw2D on device (rendering.cpp), or the software rasterizer (softrender.cpp) for headless runs.
+// This file deliberately doesn't depend on the Marmalade SDK, so the headless tools can be built with any host compiler.
+
+#include <stdint.h>
+
+// Identifiers for the images used by the game.
+// The first NUM_TEXTURES are separate textures. The rest are packed into the atlas for the current tile size
+// (see tools/makeatlas.py), so that gameplay only needs a single texture for tiles, effects and buttons.
+// Render commands always refer to a texture: normally one of the first NUM_TEXTURES, but when the game is running from
+// the prebuilt tiles group (see LoaderUsingTilesGroup) the packed images are separate textures as well.
+enum RenderImageId
+{
+    IMAGE_BACKGROUND,
+    IMAGE_LOGO,
+    IMAGE_PLAY,
+    IMAGE_ATLAS,
+    NUM_TEXTURES,
+
+    IMAGE_STAR = NUM_TEXTURES,
+    IMAGE_TILES,                                    // One tile sheet per colour (MAX_NUM_COLOURS of them)
+    IMAGE_TOUCHSCREEN_BUTTONS = IMAGE_TILES + 6,    // Rotate left/right, move left/down/right
+    IMAGE_COUNT = IMAGE_TOUCHSCREEN_BUTTONS + 5,
+};
+
+// Position of a packed image within an atlas
+struct RenderAtlasRegion
+{
+    int16_t x, y, w, h;
+};
+
+enum RenderCommandType
+{
+    RENDER_CMD_IMAGE,   // Draw a region of an image
+    RENDER_CMD_RECT,    // Fill a rectangle with the current colour
+    RENDER_CMD_STRING,  // Draw a string with the current font
+    RENDER_CMD_TILES,   // Draw a batch of tiles which all use the same texture
+    RENDER_CMD_LAYER,   // Draw the cached layer
+};
+
+// Blend modes (these match the Iw2D alpha modes used by the game)
+enum RenderAlphaMode
+{
+    RENDER_ALPHA_NONE,
+    RENDER_ALPHA_HALF,
+    RENDER_ALPHA_ADD,
+};
+
+enum RenderCommandFlags
+{
+    RENDER_FLAG_RIPPLE = 1<<0,  // The ripple post transform applies to this draw
+    RENDER_FLAG_LAYER  = 1<<1,  // This draw goes into the cached layer rather than the screen
+};
+
+// A single draw. Positions are in screen pixels with any translation already applied.
+// For RENDER_CMD_STRING, 'image' holds the horizontal alignment, 'srcX' the vertical alignment and 'srcY' the offset of the text in the string pool.
+// For RENDER_CMD_TILES, 'srcX' and 'srcY' hold the index of the first RenderTileQuad and the number of quads, 'srcW'/'srcH' the tile size in the texture,
+// and 'dstW'/'dstH' the size the tiles are drawn at.
+// The cached layer is a screen-sized image which is only redrawn when its contents change. Frames in which it changes contain
+// its draws (with RENDER_FLAG_LAYER set) ahead of the RENDER_CMD_LAYER which draws it; other frames just contain RENDER_CMD_LAYER.
+struct RenderCommand
+{
+    uint8_t type;
+    uint8_t image;
+    uint8_t alphaMode;
+    uint8_t flags;
+    uint32_t colour;    // Modulation colour, in Iw2D (ABGR) format
+    int16_t srcX, srcY, srcW, srcH;
+    int16_t dstX, dstY, dstW, dstH;
+};
+
+// A single tile within a RENDER_CMD_TILES batch
+struct RenderTileQuad
+{
+    int16_t x, y;       // Screen position
+    int16_t srcX, srcY; // Position of the tile in the texture
+};
+
+// Per-frame figures used to benchmark the renderer
+struct RenderStats
+{
+    int numCommands;
+    int numImages;          // Image draws (a batch of tiles counts as one)
+    int numTiles;           // Tiles drawn in batches
+    int numRects;           // Filled rectangles
+    int numStrings;         // Strings drawn
+    int numImageChanges;    // Number of times consecutive draws use a different image (i.e. texture binds)
+    int numStateChanges;    // Number of colour or alpha mode changes
+    int pixelsFilled;       // Total destination area, a rough measure of fill rate/bandwidth
+};
+
+#define MAX_RENDER_COMMANDS     2048
+#define MAX_RENDER_TILE_QUADS   2048
+#define RENDER_STRING_POOL_SIZE 1024
+
+struct RenderCommandBuffer
+{
+    int numCommands;
+    int numQuads;
+    int stringsUsed;
+    RenderCommand commands[MAX_RENDER_COMMANDS];
+    RenderTileQuad quads[MAX_RENDER_TILE_QUADS];
+    char strings[RENDER_STRING_POOL_SIZE];
+
+    RenderCommandBuffer()
+    {
+        Clear();
+    }
+
+    void Clear()
+    {
+        numCommands = 0;
+        numQuads = 0;
+        stringsUsed = 0;
+    }
+
+    // Returns NULL if the buffer is full (the draw is dropped)
+    RenderCommand* Add();
+
+    // Copy a string into the pool. Returns the offset of the copy, or -1 if the pool is full
+    int AddString(const char* text);
+
+    void GetStats(RenderStats& stats) const;
+};
+
+// Capture file format, used to hand recorded frames to the headless tools.
+// The file starts with RENDER_CAPTURE_MAGIC and RENDER_CAPTURE_VERSION (32 bits each), followed by frames.
+// Each frame is a RenderCaptureFrame followed by 'numCommands' RenderCommands, 'numQuads' RenderTileQuads and then 'stringsUsed' bytes of string pool.
+#define RENDER_CAPTURE_MAGIC    0x43525342  // "BSRC"
+#define RENDER_CAPTURE_VERSION  5
+
+struct RenderCaptureFrame
+{
+    uint16_t surfaceWidth;
+    uint16_t surfaceHeight;
+    uint16_t tileSize;
+    uint16_t numCommands;
+    uint16_t numQuads;
+    uint16_t pad;
+    uint32_t stringsUsed;
+    uint32_t frameTimeMs;   // Time taken by the frame when it was captured
+    uint32_t numAllocs;     // Heap allocations made during the frame (debug builds only, otherwise 0)
+    uint32_t allocBytes;
+};
+
+// Write the resource name of a texture into 'name' (which must hold at least 32 characters).
+// The atlas and the tile sheets depend on the tile size, other textures don't. Packed images are named after their
+// source images, as they are in the prebuilt tiles group.
+void RenderGetImageName(int texture, int tileSize, char* name);
+
+// Write the path of the source file for a texture, relative to the data directory, into 'path' (which must hold at least 64 characters)
+void RenderGetImagePath(int texture, int tileSize, char* path);
+
+// Find where a packed image lives in the atlas for the specified tile size.
+// Returns NULL if the image isn't packed, or there's no atlas for that tile size.
+const RenderAtlasRegion* RenderGetAtlasRegion(int image, int tileSize);
+
+#endif /* !_RENDERCOMMANDS_H */
@@ -12,151 +12,696 @@
  */
 
 #include "rendering.h"
+#include "rescache.h"
+#include "loader.h"
+#include "allocstats.h"
 #include "Iw2D.h"
-#include "IwResManager.h"
-
-// Pointers to images used by the rendering code
-CIw2DImage* backgroundImage;
-CIw2DImage* starImage;
-CIw2DImage* logoImage;
-CIw2DImage* playImage;
-CIw2DImage* tileImage[MAX_NUM_COLOURS];
-CIw2DImage* touchscreenButtonImage[5];
+#include "IwMaterial.h"
+#include "IwTexture.h"
+#include "s3eConfig.h"
+#include "s3eFile.h"
+#include "s3eTimer.h"
+
+// Post transform used for the ripple effect (see game.cpp)
+void RippleFunc(CIwSVec2* v, CIwColour* c, int32 points);
+
+// Textures used by the rendering code, indexed by RenderImageId. Only the first NUM_TEXTURES are used, unless the
+// packed images are separate textures (see LoaderUsingTilesGroup)
+CIw2DImage* g_Images[IMAGE_COUNT];
 CIw2DFont* font;
 
+RenderCommandBuffer g_RenderCommands;
+
+// State recorded with each draw
+static uint32 s_Colour = 0xffffffff;
+static RenderAlphaMode s_AlphaMode = RENDER_ALPHA_NONE;
+static int s_OriginX = 0;
+static int s_OriginY = 0;
+static uint8 s_Flags = 0;
+
+// First tile quad drawn since the last RenderFlushTiles, and the texture the pending tiles use
+static int s_FirstPendingTile = 0;
+static int s_TileImage = IMAGE_ATLAS;
+
+// Cache entries for the textures and font in use. g_Images and font point to their Iw2D objects once they're available
+static CachedResource* s_Textures[IMAGE_COUNT];
+static CachedResource* s_Font = NULL;
+
+// Incremented whenever the font changes, so that cached text sizes are measured again
+static int s_FontGeneration = 1;
+
+// Cached layer (see RenderBeginLayer)
+#ifndef IW_MKF_IW2D_LITE
+static CIw2DSurface* s_LayerSurface = NULL;
+static CIw2DImage* s_LayerImage = NULL;
+#endif
+static bool s_LayerValid = false;       // The layer holds the contents described below
+static bool s_LayerActive = false;      // Between RenderBeginLayer and RenderEndLayer, with the layer in use
+static uint32 s_LayerVersion = 0;
+static int s_LayerWidth = 0;
+static int s_LayerHeight = 0;
+static int s_LayerTileSize = 0;
+
+// Capture file for the headless tools (NULL if capturing is disabled)
+static s3eFile* s_CaptureFile = NULL;
+static bool s_CaptureChecked = false;
+static AllocCounts s_CaptureAllocs;     // Allocation totals when the last frame was captured
+static uint32 s_LastFlushTime = 0;
+
 
 int g_TileSize = 0;
 
 void CleanupImages()
 {
-    delete backgroundImage;
-    delete starImage;
-    delete logoImage;
-    delete playImage;
+    for (int i=0; i<IMAGE_COUNT; i++)
+    {
+        ResourceRelease(s_Textures[i]);
+        s_Textures[i] = NULL;
+        g_Images[i] = NULL;
+    }
 
-    int i;
-    for (i=0; i<MAX_NUM_COLOURS; i++)
-        delete tileImage[i];
+    ResourceRelease(s_Font);
+    s_Font = NULL;
+    font = NULL;
 
-    for (i=0; i < 5; i++)
-        delete touchscreenButtonImage[i];
+#ifndef IW_MKF_IW2D_LITE
+    delete s_LayerImage;
+    delete s_LayerSurface;
+    s_LayerImage = NULL;
+    s_LayerSurface = NULL;
+#endif
+    s_LayerValid = false;
 
-    delete font;
+    ResourceCacheTerminate();
+}
+
+// Lookup pointers to the title screen's materials from IwResManager
+void SetupBootImages()
+{
+    for (int i=0; i<IMAGE_ATLAS; i++)
+    {
+        char name[32];
+        RenderGetImageName(i, 0, name);
+        s_Textures[i] = ResourceAcquire(RESOURCE_IMAGE, name, 0, NULL);
+    }
+
+#ifndef IW_MKF_IW2D_LITE
+    // The background is drawn as a single quad with texture coordinates outside the image, so it needs to wrap
+    if (CIw2DImage* background = s_Textures[IMAGE_BACKGROUND]->image)
+        background->GetMaterial()->GetTexture()->SetClamping(false);
+#endif
+
+    UpdateImages();
 }
 
-// Lookup pointers to materials from IwResManager
 // This is called again if the desired tile size changes (e.g. the user rotates the screen from portrait to landscape, so the old tile size is now too large to see the whole play area)
+// The atlas and font for the new size come from the resource cache, which loads them in the background if they aren't cached already.
+// The new ones are acquired before the old ones are released, so anything used by both sizes is kept
 void SetupImages(int tileSize)
 {
-    CleanupImages();
+    char name[32];
+    char groupName[32];
+
+    if (LoaderUsingTilesGroup())
+    {
+        // Everything was loaded at startup, with each packed image in a texture of its own
+        for (int i=IMAGE_STAR; i<IMAGE_COUNT; i++)
+        {
+            RenderGetImageName(i, tileSize, name);
+            if (s_Textures[i] && !strcmp(s_Textures[i]->name, name))
+                continue;
+
+            ResourceRelease(s_Textures[i]);
+            s_Textures[i] = ResourceAcquire(RESOURCE_IMAGE, name, 0, NULL);
+        }
+
+        CachedResource* newFont = ResourceAcquire(RESOURCE_FONT, (tileSize <= 16) ? "font_small" : "font", 0, NULL);
+        ResourceRelease(s_Font);
+        s_Font = newFont;
+
+        UpdateImages();
+        return;
+    }
+
+    RenderGetImageName(IMAGE_ATLAS, tileSize, name);
+    sprintf(groupName, "tiles%d.group", tileSize);
+    CachedResource* atlas = ResourceAcquire(RESOURCE_IMAGE, name, tileSize, groupName);
+
+    // Choose font based on tile size
+    const char* fontName = (tileSize <= 16) ? "font_small" : "font";
+    sprintf(groupName, "%s.group", fontName);
+    CachedResource* newFont = ResourceAcquire(RESOURCE_FONT, fontName, 0, groupName);
+
+    ResourceRelease(s_Textures[IMAGE_ATLAS]);
+    ResourceRelease(s_Font);
+    s_Textures[IMAGE_ATLAS] = atlas;
+    s_Font = newFont;
+
+    UpdateImages();
+}
+
+void UpdateImages()
+{
+    ResourceCacheUpdate();
+
+    for (int i=0; i<IMAGE_COUNT; i++)
+        g_Images[i] = s_Textures[i] ? s_Textures[i]->image : NULL;
+
+    CIw2DFont* newFont = s_Font ? s_Font->font : NULL;
+    if (newFont != font)
+    {
+        font = newFont;
+        s_FontGeneration++;
+
+        //Set this font as the current one
+        if (font)
+            Iw2DSetFont(font);
+    }
+}
+
+bool ImagesReady()
+{
+    return g_Images[LoaderUsingTilesGroup() ? IMAGE_TILES : IMAGE_ATLAS] && font;
+}
+
+int GetImageWidth(int image)
+{
+    if (image >= NUM_TEXTURES && !LoaderUsingTilesGroup())
+        return RenderGetAtlasRegion(image, g_TileSize)->w;
+    return g_Images[image]->GetWidth();
+}
+
+int GetImageHeight(int image)
+{
+    if (image >= NUM_TEXTURES && !LoaderUsingTilesGroup())
+        return RenderGetAtlasRegion(image, g_TileSize)->h;
+    return g_Images[image]->GetHeight();
+}
+
+
+//
+// Recording ////////////////////////////////////////////////////////////////////////
+//
+
+void RenderSetColour(uint32 colour)
+{
+    s_Colour = colour;
+}
+
+void RenderSetAlphaMode(RenderAlphaMode mode)
+{
+    s_AlphaMode = mode;
+}
+
+// Set the translation applied to all subsequent draws
+void RenderSetOrigin(int x, int y)
+{
+    s_OriginX = x;
+    s_OriginY = y;
+}
+
+void RenderSetRipple(bool enable)
+{
+    if (enable)
+        s_Flags |= RENDER_FLAG_RIPPLE;
+    else
+        s_Flags &= ~RENDER_FLAG_RIPPLE;
+}
+
+static RenderCommand* AddCommand(RenderCommandType type, int x, int y, int w, int h)
+{
+    RenderCommand* c = g_RenderCommands.Add();
+    IwAssertMsg(APP, c, ("Render command buffer is full"));
+    if (!c)
+        return NULL;
+
+    c->type = (uint8)type;
+    c->alphaMode = (uint8)s_AlphaMode;
+    c->flags = s_Flags;
+    c->colour = s_Colour;
+    c->dstX = (int16)(x + s_OriginX);
+    c->dstY = (int16)(y + s_OriginY);
+    c->dstW = (int16)w;
+    c->dstH = (int16)h;
+    return c;
+}
+
+void RenderDrawImageRegion(int image, int x, int y, int w, int h, int srcX, int srcY, int srcW, int srcH)
+{
+    // Packed images are drawn from the atlas
+    if (image >= NUM_TEXTURES && !LoaderUsingTilesGroup())
+    {
+        const RenderAtlasRegion* region = RenderGetAtlasRegion(image, g_TileSize);
+        IwAssertMsg(APP, region, ("No atlas region for image %d at tile size %d", image, g_TileSize));
+        srcX += region->x;
+        srcY += region->y;
+        image = IMAGE_ATLAS;
+    }
+
+    RenderCommand* c = AddCommand(RENDER_CMD_IMAGE, x, y, w, h);
+    if (c)
+    {
+        c->image = (uint8)image;
+        c->srcX = (int16)srcX;
+        c->srcY = (int16)srcY;
+        c->srcW = (int16)srcW;
+        c->srcH = (int16)srcH;
+    }
+}
+
+void RenderDrawImage(int image, int x, int y, int w, int h)
+{
+    RenderDrawImageRegion(image, x, y, w, h, 0, 0, GetImageWidth(image), GetImageHeight(image));
+}
+
+void RenderDrawImage(int image, int x, int y)
+{
+    int w = GetImageWidth(image);
+    int h = GetImageHeight(image);
+    RenderDrawImageRegion(image, x, y, w, h, 0, 0, w, h);
+}
+
+void RenderFillRect(int x, int y, int w, int h)
+{
+    AddCommand(RENDER_CMD_RECT, x, y, w, h);
+}
+
+void RenderDrawString(const char* text, int x, int y, int w, int h, int alignH, int alignV)
+{
+    int offset = g_RenderCommands.AddString(text);
+    IwAssertMsg(APP, offset >= 0, ("Render string pool is full"));
+    if (offset < 0)
+        return;
 
-    backgroundImage = Iw2DCreateImageResource("background");
+    RenderCommand* c = AddCommand(RENDER_CMD_STRING, x, y, w, h);
+    if (c)
+    {
+        c->image = (uint8)alignH;
+        c->srcX = (int16)alignV;
+        c->srcY = (int16)offset;
+        c->srcW = c->srcH = 0;
+    }
+}
 
-    starImage = Iw2DCreateImageResource("star");
-    logoImage = Iw2DCreateImageResource("logo");
-    playImage = Iw2DCreateImageResource("play");
 
-    const char* colourNames[] =
+void RenderDrawText(RenderTextBase& text, int x, int y, int w, int h, int alignH, int alignV)
+{
+    // Text can't be measured or drawn until the font has loaded
+    if (!font || !text.text[0])
+        return;
+
+    if (text.fontGeneration != s_FontGeneration)
+    {
+        // Measure each line (no RenderText holds more than MAX_RENDER_TEXT characters)
+        char line[MAX_RENDER_TEXT];
+        int numLines = 0;
+        text.width = 0;
+        for (const char* start = text.text; start; numLines++)
+        {
+            const char* end = strchr(start, '\n');
+            int len = end ? (int)(end - start) : (int)strlen(start);
+            memcpy(line, start, len);
+            line[len] = 0;
+            text.width = MAX(text.width, Iw2DGetStringWidth(line));
+            start = end ? end + 1 : NULL;
+        }
+        text.height = numLines * font->GetHeight();
+        text.fontGeneration = s_FontGeneration;
+    }
+
+    // Text which is wider than the area (e.g. a long translation) is laid out in the whole area, so Iw2D word wraps it
+    if (text.width > w)
     {
-        "",
-        "green",
-        "red",
-        "lt_blue",
-        "purple",
-        "yellow",
+        RenderDrawString(text.text, x, y, w, h, alignH, alignV);
+        return;
+    }
+
+    // Place the measured box within the area
+    if (alignH == IW_2D_FONT_ALIGN_CENTRE)
+        x += (w - text.width) / 2;
+    else if (alignH == IW_2D_FONT_ALIGN_RIGHT)
+        x += w - text.width;
+
+    if (alignV == IW_2D_FONT_ALIGN_CENTRE)
+        y += (h - text.height) / 2;
+    else if (alignV == IW_2D_FONT_ALIGN_BOTTOM)
+        y += h - text.height;
+
+    RenderDrawString(text.text, x, y, text.width, text.height, alignH, IW_2D_FONT_ALIGN_TOP);
+}
+
+bool RenderBeginLayer(uint32 version, bool useLayer)
+{
+    RenderFlushTiles();
+
+    int width = Iw2DGetSurfaceWidth();
+    int height = Iw2DGetSurfaceHeight();
+
+#ifdef IW_MKF_IW2D_LITE
+    // Iw2D lite can't render to a surface
+    useLayer = false;
+#else
+    // The layer can't be drawn until the textures it uses have loaded
+    useLayer = useLayer && ImagesReady();
+
+    // (Re)create the surface to match the screen
+    if (useLayer && (!s_LayerSurface || width != s_LayerWidth || height != s_LayerHeight))
+    {
+        delete s_LayerImage;
+        delete s_LayerSurface;
+        s_LayerImage = NULL;
+        s_LayerValid = false;
+
+        s_LayerSurface = Iw2DCreateSurface(width, height);
+        if (s_LayerSurface)
+            s_LayerImage = Iw2DCreateImage(s_LayerSurface);
+        IwAssertMsg(APP, s_LayerImage, ("Couldn't create %dx%d surface for the cached layer", width, height));
+    }
+    useLayer = useLayer && s_LayerImage;
+#endif
+
+    if (!useLayer)
+    {
+        // The caller draws directly to the screen, which leaves the layer out of date
+        s_LayerValid = false;
+        s_LayerActive = false;
+        return true;
+    }
+
+    s_LayerActive = true;
+    if (s_LayerValid && version == s_LayerVersion && width == s_LayerWidth && height == s_LayerHeight && g_TileSize == s_LayerTileSize)
+        return false;
+
+    s_LayerValid = true;
+    s_LayerVersion = version;
+    s_LayerWidth = width;
+    s_LayerHeight = height;
+    s_LayerTileSize = g_TileSize;
+
+    s_Flags |= RENDER_FLAG_LAYER;
+    return true;
+}
+
+void RenderEndLayer()
+{
+    // The tiles drawn since RenderBeginLayer are submitted even when they went straight to the screen, so that they
+    // aren't drawn with whatever state the next batch is given
+    RenderFlushTiles();
+
+    if (!s_LayerActive)
+        return;
+    s_LayerActive = false;
+    s_Flags &= ~RENDER_FLAG_LAYER;
+
+    // The layer covers the whole screen, whatever the origin
+    RenderCommand* c = AddCommand(RENDER_CMD_LAYER, -s_OriginX, -s_OriginY, s_LayerWidth, s_LayerHeight);
+    if (c)
+    {
+        c->image = 0;
+        c->alphaMode = RENDER_ALPHA_NONE;
+        c->colour = 0xffffffff;
+        c->flags = 0;
+        c->srcX = c->srcY = 0;
+        c->srcW = (int16)s_LayerWidth;
+        c->srcH = (int16)s_LayerHeight;
+    }
+}
+
+//
+// Playback ////////////////////////////////////////////////////////////////////////
+//
+
+static void ReplayIw2D(RenderCommandBuffer const & buffer)
+{
+    static const CIw2DAlphaMode alphaModes[] =
+    {
+        IW_2D_ALPHA_NONE,
+        IW_2D_ALPHA_HALF,
+        IW_2D_ALPHA_ADD,
     };
 
-    int i;
-    for (i=0; i<MAX_NUM_COLOURS; i++)
+    uint32 colour = 0xffffffff;
+    uint8 alphaMode = RENDER_ALPHA_NONE;
+    uint8 flags = 0;
+    bool drawingLayer = false;
+
+    for (int i=0; i<buffer.numCommands; i++)
+    {
+        RenderCommand const & c = buffer.commands[i];
+
+        // Only change state when it differs from the previous draw
+        if (c.colour != colour)
+        {
+            colour = c.colour;
+            Iw2DSetColour(colour);
+        }
+        if (c.alphaMode != alphaMode)
+        {
+            alphaMode = c.alphaMode;
+            Iw2DSetAlphaMode(alphaModes[alphaMode]);
+        }
+#ifndef IW_MKF_IW2D_LITE
+        if ((c.flags ^ flags) & RENDER_FLAG_RIPPLE)
+            Iw2DSetPostTransformFn((c.flags & RENDER_FLAG_RIPPLE) ? RippleFunc : NULL);
+#endif
+        flags = c.flags;
+
+#ifndef IW_MKF_IW2D_LITE
+        // Switch between the screen and the cached layer
+        if (((c.flags & RENDER_FLAG_LAYER) != 0) != drawingLayer)
+        {
+            drawingLayer = !drawingLayer;
+            Iw2DSetSurface(drawingLayer ? s_LayerSurface : NULL);
+            if (drawingLayer)
+                Iw2DSurfaceClear(0xff000000);
+        }
+#endif
+
+        // Resources which are still loading aren't drawn
+        if (c.type == RENDER_CMD_STRING ? !font : (c.type != RENDER_CMD_RECT && c.type != RENDER_CMD_LAYER && !g_Images[c.image]))
+            continue;
+
+        switch (c.type)
+        {
+        case RENDER_CMD_IMAGE:
+            Iw2DDrawImageRegion(g_Images[c.image],
+                CIwSVec2(c.dstX, c.dstY), CIwSVec2(c.dstW, c.dstH),
+                CIwSVec2(c.srcX, c.srcY), CIwSVec2(c.srcW, c.srcH));
+            break;
+        case RENDER_CMD_RECT:
+            Iw2DFillRect(CIwSVec2(c.dstX, c.dstY), CIwSVec2(c.dstW, c.dstH));
+            break;
+        case RENDER_CMD_TILES:
+            {
+                // Iw2D merges consecutive draws from the same image into a single draw call,
+                // so each batch costs one draw however many tiles it contains
+                CIw2DImage* img = g_Images[c.image];
+                CIwSVec2 size(c.dstW, c.dstH);
+                CIwSVec2 srcSize(c.srcW, c.srcH);
+                for (int q=c.srcX; q<c.srcX+c.srcY; q++)
+                {
+                    RenderTileQuad const & quad = buffer.quads[q];
+                    Iw2DDrawImageRegion(img, CIwSVec2(quad.x, quad.y), size, CIwSVec2(quad.srcX, quad.srcY), srcSize);
+                }
+            }
+            break;
+        case RENDER_CMD_LAYER:
+#ifndef IW_MKF_IW2D_LITE
+            Iw2DDrawImage(s_LayerImage, CIwSVec2(c.dstX, c.dstY));
+#endif
+            break;
+        case RENDER_CMD_STRING:
+            Iw2DDrawString(buffer.strings + c.srcY,
+                CIwSVec2(c.dstX, c.dstY), CIwSVec2(c.dstW, c.dstH),
+                (CIw2DFontAlign)c.image, (CIw2DFontAlign)c.srcX);
+            break;
+        }
+    }
+
+    // Leave Iw2D in its default state
+#ifndef IW_MKF_IW2D_LITE
+    if (drawingLayer)
+        Iw2DSetSurface(NULL);
+#endif
+#ifndef IW_MKF_IW2D_LITE
+    if (flags & RENDER_FLAG_RIPPLE)
+        Iw2DSetPostTransformFn(NULL);
+#endif
+    Iw2DSetAlphaMode(IW_2D_ALPHA_NONE);
+    Iw2DSetColour(0xffffffff);
+}
+
+// Append the frame to the capture file, if capturing is enabled
+static void CaptureFrame(RenderCommandBuffer const & buffer, uint32 frameTimeMs)
+{
+    if (!s_CaptureChecked)
     {
-        char tmp[32];
-        sprintf(tmp, "tiles%d#%s", tileSize, colourNames[i]);
-        tileImage[i] = Iw2DCreateImageResource(tmp);
+        s_CaptureChecked = true;
+
+        char filename[S3E_CONFIG_STRING_MAX] = {0};
+        if (s3eConfigGetString("Blocslot", "RenderCapture", filename) == S3E_RESULT_SUCCESS && filename[0])
+        {
+            s_CaptureFile = s3eFileOpen(filename, "wb");
+            if (s_CaptureFile)
+            {
+                uint32 header[2] = { RENDER_CAPTURE_MAGIC, RENDER_CAPTURE_VERSION };
+                s3eFileWrite(header, sizeof(header), 1, s_CaptureFile);
+            }
+        }
     }
 
-    touchscreenButtonImage[0] = Iw2DCreateImageResource("touchscreenRotL");
-    touchscreenButtonImage[1] = Iw2DCreateImageResource("touchscreenRotR");
-    touchscreenButtonImage[2] = Iw2DCreateImageResource("touchscreenMoveL");
-    touchscreenButtonImage[3] = Iw2DCreateImageResource("touchscreenMoveDown");
-    touchscreenButtonImage[4] = Iw2DCreateImageResource("touchscreenMoveR");
+    if (!s_CaptureFile)
+        return;
+
+    RenderCaptureFrame frame;
+    frame.surfaceWidth = (uint16)Iw2DGetSurfaceWidth();
+    frame.surfaceHeight = (uint16)Iw2DGetSurfaceHeight();
+    frame.tileSize = (uint16)g_TileSize;
+    frame.numCommands = (uint16)buffer.numCommands;
+    frame.numQuads = (uint16)buffer.numQuads;
+    frame.pad = 0;
+    frame.stringsUsed = buffer.stringsUsed;
+    frame.frameTimeMs = frameTimeMs;
+
+    AllocCounts allocs = AllocGetTotal();
+    frame.numAllocs = allocs.count - s_CaptureAllocs.count;
+    frame.allocBytes = allocs.bytes - s_CaptureAllocs.bytes;
+    s_CaptureAllocs = allocs;
+
+    s3eFileWrite(&frame, sizeof(frame), 1, s_CaptureFile);
+    s3eFileWrite(buffer.commands, sizeof(RenderCommand), buffer.numCommands, s_CaptureFile);
+    s3eFileWrite(buffer.quads, sizeof(RenderTileQuad), buffer.numQuads, s_CaptureFile);
+    s3eFileWrite(buffer.strings, 1, buffer.stringsUsed, s_CaptureFile);
 }
 
-// Draw a star centered at the specified position (used for the effect when tiles explode)
-void DrawSpriteCentered(CIw2DImage* img, int x, int y, int size)
+void RenderFlush()
 {
-    Iw2DDrawImage(img, CIwSVec2(x, y) - CIwSVec2(size/2, size/2), CIwSVec2(size, size));
+    RenderFlushTiles();
+
+    uint32 now = (uint32)s3eTimerGetMs();
+    CaptureFrame(g_RenderCommands, now - s_LastFlushTime);
+    s_LastFlushTime = now;
+
+    ReplayIw2D(g_RenderCommands);
+    g_RenderCommands.Clear();
+    s_FirstPendingTile = 0;
+
+    // Reset recording state for the next frame
+    s_Colour = 0xffffffff;
+    s_AlphaMode = RENDER_ALPHA_NONE;
+    s_OriginX = s_OriginY = 0;
+    s_Flags = 0;
 }
 
 
-// Draws a background by tiling the specified material to fill the specified area
-void DrawBG(CIw2DImage* img, int x0, int y0, int w, int h)
+//
+// Drawing helpers ////////////////////////////////////////////////////////////////////////
+//
+
+// Draw a sprite centered at the specified position (used for the effect when tiles explode)
+void DrawSpriteCentered(int image, int x, int y, int size)
 {
-    // This may well go over the edges specified to the right and bottom (since it only draws complete tiles)
+    RenderDrawImage(image, x - size/2, y - size/2, size, size);
+}
 
+
+// Draws a background by tiling the specified material to fill the area from (0,0) to (w,h).
+// (scrollX,scrollY) is the position within the image which appears at the top-left corner
+void DrawBG(int image, int scrollX, int scrollY, int w, int h)
+{
     //Get Size of image
-    int img_width  = img->GetWidth();
-    int img_height = img->GetHeight();
+    int img_width  = GetImageWidth(image);
+    int img_height = GetImageHeight(image);
 
-        //Draw textured tiles
-        for (int x=x0; x<w; x += img_width)
-            for (int y=y0; y<h; y += img_height)
-                Iw2DDrawImage(img, CIwSVec2(x, y));
+    scrollX %= img_width;
+    scrollY %= img_height;
+    if (scrollX < 0)
+        scrollX += img_width;
+    if (scrollY < 0)
+        scrollY += img_height;
+
+#ifndef IW_MKF_IW2D_LITE
+    // The texture wraps (see SetupBootImages), so a single quad covers the whole area
+    RenderDrawImageRegion(image, 0, 0, w, h, scrollX, scrollY, w, h);
+#else
+    // Without access to the texture's clamping, draw textured tiles instead
+    for (int x=-scrollX; x<w; x += img_width)
+        for (int y=-scrollY; y<h; y += img_height)
+            RenderDrawImage(image, x, y, img_width, img_height);
+#endif
 }
 
 // Draws a half-transparent black rectangle at the location
 void DrawBlackBG(int x0, int y0, int w, int h)
 {
     // Draw background for playing area
-    Iw2DSetColour(0);
-    Iw2DSetAlphaMode(IW_2D_ALPHA_HALF);
-    Iw2DFillRect(CIwSVec2(x0, y0), CIwSVec2(w, h));
-    Iw2DSetColour(0xffffffff);
-    Iw2DSetAlphaMode(IW_2D_ALPHA_NONE);
+    RenderSetColour(0);
+    RenderSetAlphaMode(RENDER_ALPHA_HALF);
+    RenderFillRect(x0, y0, w, h);
+    RenderSetColour(0xffffffff);
+    RenderSetAlphaMode(RENDER_ALPHA_NONE);
 }
 
-// Draw a tile
-void DrawTile(int colour, int x, int y, int size, uint32 connectFlags)
+// Which part of the tile sheet to use for each combination of ConnectFlags.
+// Columns (bits 0-1) are picked by the left/right connections and rows (bits 2-3) by the up/down connections:
+// 0 = not connected, 1 = right/down only, 2 = both, 3 = left/up only
+static const uint8 s_ConnectTileType[16] =
 {
-    IwAssertMsg(APP, colour >= 0 && colour < MAX_NUM_COLOURS, ("Illegal colour for DrawTile (%d)", colour));
+    0, 12, 3, 15, 4, 8, 7, 11, 1, 13, 2, 14, 5, 9, 6, 10,
+};
 
-    int tileTypeX, tileTypeY;
+// Draw a tile.
+// Tiles are written straight into the command buffer and then submitted by RenderFlushTiles as a single batch,
+// since every tile sheet is in the same atlas
+void DrawTile(int colour, int x, int y, uint32 connectFlags)
+{
+    IwAssertMsg(APP, colour >= 0 && colour < MAX_NUM_COLOURS, ("Illegal colour for DrawTile (%d)", colour));
+    IwAssertMsg(APP, g_RenderCommands.numQuads < MAX_RENDER_TILE_QUADS, ("Render tile buffer is full"));
+    if (g_RenderCommands.numQuads >= MAX_RENDER_TILE_QUADS)
+        return;
 
-    // Pick the appropriate part of the tile material to match the connections of this tile
-    if (connectFlags & CONNECT_UP)
+    int image = IMAGE_ATLAS;
+    int srcX = 0;
+    int srcY = 0;
+    if (LoaderUsingTilesGroup())
     {
-        if (connectFlags & CONNECT_DOWN)
-            tileTypeY = 2;
-        else
-            tileTypeY = 3;
+        // Each tile sheet is a texture of its own, so a batch can only hold one colour
+        image = IMAGE_TILES + colour;
+        if (image != s_TileImage)
+            RenderFlushTiles();
     }
     else
     {
-        if (connectFlags & CONNECT_DOWN)
-            tileTypeY = 1;
-        else
-            tileTypeY = 0;
+        const RenderAtlasRegion* region = RenderGetAtlasRegion(IMAGE_TILES + colour, g_TileSize);
+        srcX = region->x;
+        srcY = region->y;
     }
+    s_TileImage = image;
 
-    if (connectFlags & CONNECT_LEFT)
-    {
-        if (connectFlags & CONNECT_RIGHT)
-            tileTypeX = 2;
-        else
-            tileTypeX = 3;
-    }
-    else
+    uint8 tileType = s_ConnectTileType[connectFlags & 15];
+
+    RenderTileQuad& quad = g_RenderCommands.quads[g_RenderCommands.numQuads++];
+    quad.x = (int16)(x + s_OriginX);
+    quad.y = (int16)(y + s_OriginY);
+    quad.srcX = (int16)(srcX + (tileType & 3) * g_TileSize);
+    quad.srcY = (int16)(srcY + (tileType >> 2) * g_TileSize);
+}
+
+void RenderFlushTiles()
+{
+    int count = g_RenderCommands.numQuads - s_FirstPendingTile;
+    if (!count)
+        return;
+
+    RenderCommand* c = AddCommand(RENDER_CMD_TILES, 0, 0, g_TileSize, g_TileSize);
+    if (c)
     {
-        if (connectFlags & CONNECT_RIGHT)
-            tileTypeX = 1;
-        else
-            tileTypeX = 0;
+        c->image = (uint8)s_TileImage;
+        c->dstX = c->dstY = 0;
+        c->srcX = (int16)s_FirstPendingTile;
+        c->srcY = (int16)count;
+        c->srcW = c->srcH = (int16)g_TileSize;
     }
 
-
-    Iw2DDrawImageRegion(
-        tileImage[colour],
-        CIwSVec2(x, y),
-        CIwSVec2(tileTypeX * g_TileSize, tileTypeY * g_TileSize),
-        CIwSVec2(g_TileSize, g_TileSize)
-        );
+    s_FirstPendingTile = g_RenderCommands.numQuads;
 }
@@ -15,25 +15,60 @@
 #define _RENDERING_H
 
 #include "game.h"
+#include "rendercommands.h"
+#include "rendertext.h"
 
 // Foward declarations
 class CIw2DImage;
 class CIw2DFont;
 
-extern CIw2DImage* backgroundImage;
-extern CIw2DImage* starImage;
-extern CIw2DImage* logoImage;
-extern CIw2DImage* playImage;
-extern CIw2DImage* tileImage[MAX_NUM_COLOURS];
-extern CIw2DImage* touchscreenButtonImage[5];
+extern CIw2DImage* g_Images[IMAGE_COUNT];
 extern CIw2DFont* font;
 
+// Images are set up in stages: the title screen's images are available from startup, and the atlas and font once
+// they've been loaded in the background (see loader.h)
 void CleanupImages();
+void SetupBootImages();
 void SetupImages(int tileSize);
-void DrawSpriteCentered(CIw2DImage* img, int x, int y, int size);
-void DrawBG(CIw2DImage* img, int x0, int y0, int w, int h);
+void UpdateImages();        // Called once per frame, to pick up resources which have finished loading
+bool ImagesReady();         // True once everything needed for gameplay is available
+int GetImageWidth(int image);
+int GetImageHeight(int image);
+
+// Draws are recorded into g_RenderCommands rather than being submitted immediately.
+// These set the state which is recorded with each draw.
+void RenderSetColour(uint32 colour);
+void RenderSetAlphaMode(RenderAlphaMode mode);
+void RenderSetOrigin(int x, int y);
+void RenderSetRipple(bool enable);
+
+void RenderDrawImage(int image, int x, int y);
+void RenderDrawImage(int image, int x, int y, int w, int h);
+void RenderDrawImageRegion(int image, int x, int y, int w, int h, int srcX, int srcY, int srcW, int srcH);
+void RenderFillRect(int x, int y, int w, int h);
+void RenderDrawString(const char* text, int x, int y, int w, int h, int alignH, int alignV);
+
+void DrawSpriteCentered(int image, int x, int y, int size);
+void DrawBG(int image, int scrollX, int scrollY, int w, int h);
 void DrawBlackBG(int x0, int y0, int w, int h);
-void DrawTile(int colour, int x, int y, int size, uint32 connectFlags);
+void DrawTile(int colour, int x, int y, uint32 connectFlags);
+
+// Submit the tiles drawn with DrawTile since the last call as a single batch
+void RenderFlushTiles();
+
+// Cached layer: a screen-sized offscreen surface for content which rarely changes.
+// RenderBeginLayer returns true if the caller needs to draw the layer's contents, i.e. if 'version' or the screen size has changed
+// since it was last drawn. The draws up to RenderEndLayer go into the layer, and RenderEndLayer then draws it to the screen.
+// If 'useLayer' is false (or surfaces aren't available), it always returns true and the contents are drawn straight to the screen.
+// Either way, RenderEndLayer submits the tiles drawn since RenderBeginLayer.
+bool RenderBeginLayer(uint32 version, bool useLayer);
+void RenderEndLayer();
+
+// Replay the recorded draws with Iw2D, then clear the buffer. Called once per frame before Iw2DSurfaceShow.
+// If the RenderCapture setting is present in app.icf, the frame is also appended to that file for the headless tools.
+void RenderFlush();
+
+extern RenderCommandBuffer g_RenderCommands;
 
 // Global variable used by the rendering functions to scale graphics.
 extern int g_TileSize;
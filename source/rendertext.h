@@ -0,0 +1,76 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _RENDERTEXT_H
+#define _RENDERTEXT_H
+
+#include "IwDebug.h"
+#include "localise.h"
+
+#include <string.h>
+
+// Longest text RenderText can hold by default, enough for the score line, i.e. two localised labels and two numbers.
+// Text which is always short (e.g. score popups) can use a RenderTextSized with a smaller buffer
+#define MAX_RENDER_TEXT (MAX_LOCALISED_STRING*2 + 32)
+
+// A string whose size is measured once and then kept until the text or the font changes.
+// Drawing it only lays out the text within its own measured box, rather than a large area.
+// The characters are stored by RenderTextSized (below), which sets 'text' to its own buffer, so these can't be copied.
+struct RenderTextBase
+{
+    char* text;
+    int capacity;           // Size of the buffer 'text' points to, including the terminator
+    int fontGeneration;     // Font the size was measured with (0 if it needs measuring)
+    int width, height;      // Size of the text in pixels
+
+    // Returns true if the text changed
+    bool Set(const char* newText)
+    {
+        if (!strcmp(text, newText))
+            return false;
+
+        IwAssertMsg(APP, (int)strlen(newText) < capacity, ("Text is too long for RenderText: %s", newText));
+        strncpy(text, newText, capacity - 1);
+        text[capacity - 1] = 0;
+        fontGeneration = 0;
+        width = height = 0;
+        return true;
+    }
+
+protected:
+    RenderTextBase(char* buffer, int bufferSize) : text(buffer), capacity(bufferSize), fontGeneration(0), width(0), height(0)
+    {
+        text[0] = 0;
+    }
+
+private:
+    RenderTextBase(RenderTextBase const &);
+    RenderTextBase & operator = (RenderTextBase const &);
+};
+
+// RenderTextBase with room for text of up to SIZE-1 characters (no more than MAX_RENDER_TEXT-1)
+template <int SIZE> struct RenderTextSized : public RenderTextBase
+{
+    typedef char SizeFitsRenderText[SIZE <= MAX_RENDER_TEXT ? 1 : -1];
+
+    char buffer[SIZE];
+
+    RenderTextSized() : RenderTextBase(buffer, SIZE) {}
+};
+
+typedef RenderTextSized<MAX_RENDER_TEXT> RenderText;
+
+// Draw the text aligned within the specified area
+void RenderDrawText(RenderTextBase& text, int x, int y, int w, int h, int alignH, int alignV);
+
+#endif /* !_RENDERTEXT_H */
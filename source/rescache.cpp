@@ -0,0 +1,162 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "Iw2D.h"
+#include "IwResManager.h"
+#include "rescache.h"
+#include "loader.h"
+#include "s3eConfig.h"
+
+#include <string.h>
+
+static CachedResource s_Cache[MAX_CACHED_RESOURCES];
+static bool s_InUse[MAX_CACHED_RESOURCES];
+
+// Incremented on every acquire/release, to order entries by when they were last used
+static uint32 s_UseCounter = 0;
+
+// Unreferenced entries to keep (-1 until it's been read from the settings)
+static int s_UnusedLimit = -1;
+
+static int GetUnusedLimit()
+{
+    if (s_UnusedLimit < 0)
+    {
+        s_UnusedLimit = RESOURCE_CACHE_UNUSED_DEFAULT;
+        s3eConfigGetInt("Blocslot", "ResourceCacheUnused", &s_UnusedLimit);
+        if (s_UnusedLimit < 0)
+            s_UnusedLimit = 0;
+    }
+    return s_UnusedLimit;
+}
+
+// Create the Iw2D object once its resource is available
+static void CreateObject(CachedResource& res)
+{
+    if (res.image || res.font || (res.ownsGroup && !res.group))
+        return;
+
+    if (res.type == RESOURCE_IMAGE)
+        res.image = Iw2DCreateImageResource(res.name);
+    else
+        res.font = Iw2DCreateFontResource(res.name);
+}
+
+static void Destroy(int i)
+{
+    CachedResource& res = s_Cache[i];
+
+    delete res.image;
+    delete res.font;
+
+    if (res.ownsGroup)
+    {
+        LoaderCancel(&res.group);
+        if (res.group)
+            IwGetResManager()->DestroyGroup(res.group);
+    }
+
+    memset(&res, 0, sizeof(res));
+    s_InUse[i] = false;
+}
+
+// Destroy the least recently used unreferenced entries, until no more than 'limit' remain
+static void Evict(int limit)
+{
+    while (1)
+    {
+        int numUnused = 0;
+        int oldest = -1;
+        for (int i=0; i<MAX_CACHED_RESOURCES; i++)
+        {
+            if (!s_InUse[i] || s_Cache[i].refCount)
+                continue;
+
+            numUnused++;
+            if (oldest == -1 || s_Cache[i].lastUsed < s_Cache[oldest].lastUsed)
+                oldest = i;
+        }
+
+        if (numUnused <= limit)
+            return;
+
+        Destroy(oldest);
+    }
+}
+
+CachedResource* ResourceAcquire(CachedResourceType type, const char* name, int tileSize, const char* groupFilename)
+{
+    int i;
+    for (i=0; i<MAX_CACHED_RESOURCES; i++)
+    {
+        CachedResource& res = s_Cache[i];
+        if (s_InUse[i] && res.type == type && res.tileSize == tileSize && !strcmp(res.name, name))
+        {
+            res.refCount++;
+            res.lastUsed = ++s_UseCounter;
+            return &res;
+        }
+    }
+
+    // Not cached, so make room for a new entry
+    int limit = GetUnusedLimit();
+    Evict(limit > 0 ? limit - 1 : 0);
+    for (i=0; i<MAX_CACHED_RESOURCES && s_InUse[i]; i++)
+        ;
+    IwAssertMsg(APP, i < MAX_CACHED_RESOURCES, ("Resource cache is full"));
+    IwAssertMsg(APP, strlen(name) < sizeof(s_Cache[i].name), ("Resource name too long (%s)", name));
+
+    CachedResource& res = s_Cache[i];
+    s_InUse[i] = true;
+    memset(&res, 0, sizeof(res));
+    res.type = type;
+    strcpy(res.name, name);
+    res.tileSize = tileSize;
+    res.refCount = 1;
+    res.lastUsed = ++s_UseCounter;
+
+    if (groupFilename)
+    {
+        res.ownsGroup = true;
+        LoaderQueueGroup(groupFilename, &res.group);
+    }
+
+    CreateObject(res);
+    return &res;
+}
+
+void ResourceRelease(CachedResource* res)
+{
+    if (!res)
+        return;
+
+    IwAssertMsg(APP, res->refCount > 0, ("Resource %s released too many times", res->name));
+    res->refCount--;
+    res->lastUsed = ++s_UseCounter;
+
+    Evict(GetUnusedLimit());
+}
+
+void ResourceCacheUpdate()
+{
+    for (int i=0; i<MAX_CACHED_RESOURCES; i++)
+        if (s_InUse[i])
+            CreateObject(s_Cache[i]);
+}
+
+void ResourceCacheTerminate()
+{
+    for (int i=0; i<MAX_CACHED_RESOURCES; i++)
+        if (s_InUse[i])
+            Destroy(i);
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _RESCACHE_H
+#define _RESCACHE_H
+
+#include "s3eTypes.h"
+
+// Cache of Iw2D images and fonts, keyed by resource name and tile size (0 for resources which don't depend on it).
+// Entries are reference counted. By default an entry is destroyed as soon as it's no longer referenced, so only the
+// atlas and font for the tile size in use stay loaded. ResourceCacheUnused in app.icf keeps up to that many unreferenced
+// entries (the least recently used ones are destroyed first), so that switching back to a tile size (e.g. rotating
+// the device back) doesn't load anything again, at the cost of memory.
+// An entry can own the resource group its resource lives in. The group is loaded in the background when the entry is
+// created (see loader.h) and destroyed along with the entry.
+
+class CIwResGroup;
+class CIw2DImage;
+class CIw2DFont;
+
+// Enough for every image as a separate texture (see LoaderUsingTilesGroup), plus the unused entries
+#define MAX_CACHED_RESOURCES        24
+#define RESOURCE_CACHE_UNUSED_DEFAULT 0
+
+enum CachedResourceType
+{
+    RESOURCE_IMAGE,
+    RESOURCE_FONT,
+};
+
+struct CachedResource
+{
+    CachedResourceType type;
+    char name[32];
+    int tileSize;
+    bool ownsGroup;
+    CIwResGroup* group;     // Owned group (NULL until it has loaded)
+    CIw2DImage* image;      // NULL until the resource is available
+    CIw2DFont* font;
+    int refCount;
+    uint32 lastUsed;
+};
+
+// Find or create an entry, and add a reference to it. 'groupFilename' is the group to load for it, or NULL if the
+// resource is in a group which is already loaded
+CachedResource* ResourceAcquire(CachedResourceType type, const char* name, int tileSize, const char* groupFilename);
+
+// Remove a reference (NULL is ignored)
+void ResourceRelease(CachedResource* res);
+
+// Create the Iw2D objects for entries whose groups have finished loading. Called once per frame
+void ResourceCacheUpdate();
+
+// Destroy every entry, referenced or not
+void ResourceCacheTerminate();
+
+#endif /* !_RESCACHE_H */
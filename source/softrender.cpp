@@ -0,0 +1,440 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "softrender.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Read little-endian values from a file header
+static uint32_t ReadU32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t ReadU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+SoftRenderer::SoftRenderer(const char* _dataPath)
+{
+    dataPath = _dataPath;
+    width = height = 0;
+    frame = NULL;
+    layer = NULL;
+    target = NULL;
+    images = NULL;
+    numImages = 0;
+}
+
+SoftRenderer::~SoftRenderer()
+{
+    for (int i=0; i<numImages; i++)
+        free(images[i].pixels);
+    free(images);
+    free(frame);
+    free(layer);
+}
+
+bool SoftRenderer::LoadBMP(Image& img, const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+        return false;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t* data = (uint8_t*)malloc(size);
+    bool ok = size > 54 && fread(data, 1, size, f) == (size_t)size && data[0] == 'B' && data[1] == 'M';
+    fclose(f);
+
+    uint32_t dataOffset = 0, headerSize = 0, bpp = 0, compression = 0, numColours = 0;
+    int32_t w = 0, h = 0;
+    if (ok)
+    {
+        dataOffset = ReadU32(data + 10);
+        headerSize = ReadU32(data + 14);
+        w = (int32_t)ReadU32(data + 18);
+        h = (int32_t)ReadU32(data + 22);
+        bpp = ReadU16(data + 28);
+        compression = ReadU32(data + 30);
+        numColours = ReadU32(data + 46);
+        if (!numColours && bpp <= 8)
+            numColours = 1 << bpp;
+
+        // Only uncompressed images are used by the game
+        ok = compression == 0 && w > 0 && h != 0 && (bpp == 4 || bpp == 8 || bpp == 24 || bpp == 32);
+    }
+
+    if (!ok)
+    {
+        free(data);
+        return false;
+    }
+
+    // Rows are stored bottom-up unless the height is negative
+    bool bottomUp = h > 0;
+    if (h < 0)
+        h = -h;
+
+    const uint8_t* palette = data + 14 + headerSize;
+    int stride = ((w * bpp + 31) / 32) * 4;
+
+    img.width = w;
+    img.height = h;
+    img.pixels = (uint32_t*)malloc(w * h * sizeof(uint32_t));
+
+    for (int y=0; y<h; y++)
+    {
+        const uint8_t* row = data + dataOffset + (bottomUp ? h-1-y : y) * stride;
+        for (int x=0; x<w; x++)
+        {
+            uint32_t r, g, b;
+            if (bpp <= 8)
+            {
+                uint32_t index = (bpp == 8) ? row[x] : ((x & 1) ? row[x/2] & 15 : row[x/2] >> 4);
+                const uint8_t* p = palette + 4 * (index < numColours ? index : 0);
+                b = p[0]; g = p[1]; r = p[2];
+            }
+            else
+            {
+                const uint8_t* p = row + x * (bpp/8);
+                b = p[0]; g = p[1]; r = p[2];
+            }
+
+            // Magenta is transparent
+            uint32_t a = (r == 255 && g == 0 && b == 255) ? 0 : 255;
+            img.pixels[x + y*w] = (a << 24) | (r << 16) | (g << 8) | b;
+        }
+    }
+
+    free(data);
+    return true;
+}
+
+bool SoftRenderer::LoadTGA(Image& img, const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+        return false;
+
+    // Only uncompressed 24 and 32 bit true-colour images are supported
+    uint8_t header[18];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) || header[1] != 0 || header[2] != 2
+        || (header[16] != 24 && header[16] != 32))
+    {
+        fclose(f);
+        return false;
+    }
+    fseek(f, header[0], SEEK_CUR);
+
+    int w = ReadU16(header + 12);
+    int h = ReadU16(header + 14);
+    int bytesPerPixel = header[16] / 8;
+    bool bottomUp = !(header[17] & 0x20);
+
+    img.width = w;
+    img.height = h;
+    img.pixels = (uint32_t*)malloc(w * h * sizeof(uint32_t));
+
+    bool ok = true;
+    uint8_t* row = (uint8_t*)malloc(w * bytesPerPixel);
+    for (int y=0; y<h && ok; y++)
+    {
+        ok = fread(row, 1, w * bytesPerPixel, f) == (size_t)(w * bytesPerPixel);
+
+        uint32_t* dst = img.pixels + (bottomUp ? h-1-y : y) * w;
+        for (int x=0; x<w && ok; x++)
+        {
+            const uint8_t* p = row + x * bytesPerPixel;
+            uint32_t a = (bytesPerPixel == 4) ? p[3] : 255;
+            dst[x] = (a << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+        }
+    }
+    free(row);
+    fclose(f);
+
+    if (!ok)
+    {
+        free(img.pixels);
+        img.pixels = NULL;
+    }
+    return ok;
+}
+
+SoftRenderer::Image* SoftRenderer::GetImage(int image, int tileSize)
+{
+    char name[32];
+    RenderGetImageName(image, tileSize, name);
+
+    for (int i=0; i<numImages; i++)
+        if (!strcmp(images[i].name, name))
+            return images[i].pixels ? &images[i] : NULL;
+
+    // Not seen before, so load it
+    char path[64];
+    char filename[512];
+    RenderGetImagePath(image, tileSize, path);
+    snprintf(filename, sizeof(filename), "%s/%s", dataPath, path);
+
+    images = (Image*)realloc(images, (numImages + 1) * sizeof(Image));
+    Image& img = images[numImages++];
+    strcpy(img.name, name);
+    img.width = img.height = 0;
+    img.pixels = NULL;
+
+    size_t len = strlen(filename);
+    bool isTGA = len > 4 && !strcmp(filename + len - 4, ".tga");
+    if (!(isTGA ? LoadTGA(img, filename) : LoadBMP(img, filename)))
+    {
+        fprintf(stderr, "softrender: couldn't load %s\n", filename);
+        return NULL;
+    }
+    return &img;
+}
+
+void SoftRenderer::Blend(uint8_t* dst, uint32_t r, uint32_t g, uint32_t b, int alphaMode)
+{
+    switch (alphaMode)
+    {
+    case RENDER_ALPHA_NONE:
+        dst[0] = (uint8_t)r;
+        dst[1] = (uint8_t)g;
+        dst[2] = (uint8_t)b;
+        break;
+    case RENDER_ALPHA_HALF:
+        dst[0] = (uint8_t)((dst[0] + r) >> 1);
+        dst[1] = (uint8_t)((dst[1] + g) >> 1);
+        dst[2] = (uint8_t)((dst[2] + b) >> 1);
+        break;
+    case RENDER_ALPHA_ADD:
+        r += dst[0];
+        g += dst[1];
+        b += dst[2];
+        dst[0] = (uint8_t)(r > 255 ? 255 : r);
+        dst[1] = (uint8_t)(g > 255 ? 255 : g);
+        dst[2] = (uint8_t)(b > 255 ? 255 : b);
+        break;
+    }
+}
+
+void SoftRenderer::DrawImage(RenderCommand const & c, Image const & img)
+{
+    if (c.dstW <= 0 || c.dstH <= 0)
+        return;
+
+    // Modulation colour is in ABGR format
+    uint32_t cr = c.colour & 0xff;
+    uint32_t cg = (c.colour >> 8) & 0xff;
+    uint32_t cb = (c.colour >> 16) & 0xff;
+
+    int x0 = c.dstX < 0 ? 0 : c.dstX;
+    int y0 = c.dstY < 0 ? 0 : c.dstY;
+    int x1 = c.dstX + c.dstW > width ? width : c.dstX + c.dstW;
+    int y1 = c.dstY + c.dstH > height ? height : c.dstY + c.dstH;
+
+    for (int y=y0; y<y1; y++)
+    {
+        // Point sampling. Coordinates outside the image wrap around
+        int sy = (c.srcY + (y - c.dstY) * c.srcH / c.dstH) % img.height;
+        if (sy < 0)
+            sy += img.height;
+
+        uint8_t* dst = target + 3 * (x0 + y*width);
+        for (int x=x0; x<x1; x++, dst+=3)
+        {
+            int sx = (c.srcX + (x - c.dstX) * c.srcW / c.dstW) % img.width;
+            if (sx < 0)
+                sx += img.width;
+
+            uint32_t texel = img.pixels[sx + sy*img.width];
+            if (!(texel >> 24))
+                continue;
+
+            Blend(dst,
+                ((texel >> 16) & 0xff) * cr / 255,
+                ((texel >> 8) & 0xff) * cg / 255,
+                (texel & 0xff) * cb / 255,
+                c.alphaMode);
+        }
+    }
+}
+
+void SoftRenderer::FillRect(RenderCommand const & c)
+{
+    int x0 = c.dstX < 0 ? 0 : c.dstX;
+    int y0 = c.dstY < 0 ? 0 : c.dstY;
+    int x1 = c.dstX + c.dstW > width ? width : c.dstX + c.dstW;
+    int y1 = c.dstY + c.dstH > height ? height : c.dstY + c.dstH;
+
+    for (int y=y0; y<y1; y++)
+        for (int x=x0; x<x1; x++)
+            Blend(target + 3 * (x + y*width), c.colour & 0xff, (c.colour >> 8) & 0xff, (c.colour >> 16) & 0xff, c.alphaMode);
+}
+
+void SoftRenderer::DrawLayer(RenderCommand const & c)
+{
+    int x0 = c.dstX < 0 ? 0 : c.dstX;
+    int y0 = c.dstY < 0 ? 0 : c.dstY;
+    int x1 = c.dstX + c.dstW > width ? width : c.dstX + c.dstW;
+    int y1 = c.dstY + c.dstH > height ? height : c.dstY + c.dstH;
+    if (x1 <= x0)
+        return;
+
+    for (int y=y0; y<y1; y++)
+        memcpy(frame + 3 * (x0 + y*width), layer + 3 * ((x0 - c.dstX) + (y - c.dstY)*width), 3 * (x1 - x0));
+}
+
+void SoftRenderer::Render(RenderCommandBuffer const & buffer, int surfaceWidth, int surfaceHeight, int tileSize)
+{
+    if (surfaceWidth != width || surfaceHeight != height)
+    {
+        width = surfaceWidth;
+        height = surfaceHeight;
+        free(frame);
+        free(layer);
+        frame = (uint8_t*)malloc(width * height * 3);
+        layer = (uint8_t*)calloc(width * height * 3, 1);
+    }
+    memset(frame, 0, width * height * 3);
+
+    bool drawingLayer = false;
+    for (int i=0; i<buffer.numCommands; i++)
+    {
+        RenderCommand const & c = buffer.commands[i];
+
+        // The layer is cleared whenever it's redrawn
+        bool toLayer = (c.flags & RENDER_FLAG_LAYER) != 0;
+        if (toLayer && !drawingLayer)
+            memset(layer, 0, width * height * 3);
+        drawingLayer = toLayer;
+        target = toLayer ? layer : frame;
+
+        switch (c.type)
+        {
+        case RENDER_CMD_IMAGE:
+            if (Image* img = GetImage(c.image, tileSize))
+                DrawImage(c, *img);
+            break;
+        case RENDER_CMD_RECT:
+            FillRect(c);
+            break;
+        case RENDER_CMD_TILES:
+            if (Image* img = GetImage(c.image, tileSize))
+            {
+                // Draw each tile in the batch as an image command
+                RenderCommand tile = c;
+                tile.type = RENDER_CMD_IMAGE;
+                for (int q=c.srcX; q<c.srcX+c.srcY; q++)
+                {
+                    RenderTileQuad const & quad = buffer.quads[q];
+                    tile.dstX = quad.x;
+                    tile.dstY = quad.y;
+                    tile.srcX = quad.srcX;
+                    tile.srcY = quad.srcY;
+                    DrawImage(tile, *img);
+                }
+            }
+            break;
+        case RENDER_CMD_LAYER:
+            DrawLayer(c);
+            break;
+        case RENDER_CMD_STRING:
+            // Fonts aren't supported by the software renderer
+            break;
+        }
+    }
+}
+
+bool SoftRenderer::WriteTGA(const char* filename) const
+{
+    FILE* f = fopen(filename, "wb");
+    if (!f)
+        return false;
+
+    // Uncompressed true-colour, top-left origin
+    uint8_t header[18] = {0};
+    header[2] = 2;
+    header[12] = (uint8_t)(width & 0xff);
+    header[13] = (uint8_t)(width >> 8);
+    header[14] = (uint8_t)(height & 0xff);
+    header[15] = (uint8_t)(height >> 8);
+    header[16] = 24;
+    header[17] = 0x20;
+    fwrite(header, 1, sizeof(header), f);
+
+    // TGA stores BGR
+    uint8_t* row = (uint8_t*)malloc(width * 3);
+    for (int y=0; y<height; y++)
+    {
+        const uint8_t* src = frame + y * width * 3;
+        for (int x=0; x<width; x++)
+        {
+            row[x*3+0] = src[x*3+2];
+            row[x*3+1] = src[x*3+1];
+            row[x*3+2] = src[x*3+0];
+        }
+        fwrite(row, 1, width * 3, f);
+    }
+    free(row);
+
+    return fclose(f) == 0;
+}
+
+int SoftRenderer::CompareTGA(const char* filename, int tolerance) const
+{
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+        return -1;
+
+    uint8_t header[18];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) || header[2] != 2 || header[16] != 24
+        || ReadU16(header + 12) != width || ReadU16(header + 14) != height)
+    {
+        fclose(f);
+        return -1;
+    }
+    fseek(f, header[0], SEEK_CUR);
+
+    int differences = 0;
+    uint8_t* row = (uint8_t*)malloc(width * 3);
+    for (int y=0; y<height; y++)
+    {
+        if (fread(row, 1, width * 3, f) != (size_t)(width * 3))
+        {
+            differences = -1;
+            break;
+        }
+
+        const uint8_t* src = frame + y * width * 3;
+        for (int x=0; x<width; x++)
+        {
+            for (int ch=0; ch<3; ch++)
+            {
+                if (abs((int)row[x*3+2-ch] - (int)src[x*3+ch]) > tolerance)
+                {
+                    differences++;
+                    break;
+                }
+            }
+        }
+    }
+    free(row);
+    fclose(f);
+
+    return differences;
+}
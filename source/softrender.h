@@ -0,0 +1,64 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _SOFTRENDER_H
+#define _SOFTRENDER_H
+
+// Software rasterizer backend for the render command buffer.
+// Like rendercommands.h this doesn't depend on the Marmalade SDK, so it can be used by headless tools on any host.
+// Textures are loaded directly from the .bmp files in the data directory, using magenta as the transparent colour (as IwGx does),
+// and from the .tga atlases written by tools/makeatlas.py.
+// Strings are counted but not drawn, and the ripple post transform is ignored.
+
+#include "rendercommands.h"
+
+struct SoftRenderer
+{
+    struct Image
+    {
+        char name[32];
+        int width, height;
+        uint32_t* pixels;   // 0xAARRGGBB. Transparent pixels have zero alpha
+    };
+
+    const char* dataPath;
+    int width, height;
+    uint8_t* frame;         // RGB, 3 bytes per pixel
+    uint8_t* layer;         // Cached layer, the same size and format as the frame. Kept from one frame to the next
+    uint8_t* target;        // Which of the above is being drawn to
+    Image* images;
+    int numImages;
+
+    SoftRenderer(const char* _dataPath);
+    ~SoftRenderer();
+
+    // Rasterize a frame of commands. The frame is cleared to black first
+    void Render(RenderCommandBuffer const & buffer, int surfaceWidth, int surfaceHeight, int tileSize);
+
+    bool WriteTGA(const char* filename) const;
+
+    // Compare the current frame against a TGA written by WriteTGA.
+    // Returns the number of pixels that differ by more than 'tolerance' in any channel, or -1 if the file couldn't be read
+    int CompareTGA(const char* filename, int tolerance) const;
+
+private:
+    Image* GetImage(int image, int tileSize);
+    bool LoadBMP(Image& img, const char* filename);
+    bool LoadTGA(Image& img, const char* filename);
+    void DrawImage(RenderCommand const & c, Image const & img);
+    void FillRect(RenderCommand const & c);
+    void DrawLayer(RenderCommand const & c);
+    void Blend(uint8_t* dst, uint32_t r, uint32_t g, uint32_t b, int alphaMode);
+};
+
+#endif /* !_SOFTRENDER_H */
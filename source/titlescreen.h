@@ -58,8 +58,8 @@ public:
         {
             int x = s3ePointerGetX();
             int y = s3ePointerGetY();
-            int width = playImage->GetWidth();
-            int height = playImage->GetHeight();
+            int width = GetImageWidth(IMAGE_PLAY);
+            int height = GetImageHeight(IMAGE_PLAY);
 
             if ((x >= playX & x <= playX + width)
                 & (y >= playY & y <= playY + height)
@@ -79,6 +79,12 @@ public:
         }
     }
 
+    // The background scrolls a pixel every 16ms, so it needs the full frame rate to move smoothly
+    bool IsAnimating() const
+    {
+        return true;
+    }
+
     void Render()
     {
         int displayWidth  = Iw2DGetSurfaceWidth();
@@ -87,10 +93,10 @@ public:
         // Draw background, scrolling diagonally
         int scrollPosition = (timer >> 4) % 128;
 
-        DrawBG(backgroundImage, -scrollPosition, -scrollPosition, displayWidth+128, displayHeight+128);
+        DrawBG(IMAGE_BACKGROUND, scrollPosition, scrollPosition, displayWidth, displayHeight);
 
         // Draw title logo centered on screen
-        int x = displayWidth/2 - logoImage->GetWidth()/2;
+        int x = displayWidth/2 - GetImageWidth(IMAGE_LOGO)/2;
         int y = 0;
 
         if (displayHeight > 176)
@@ -98,12 +104,12 @@ public:
 
         // Draw a sprite at the specified position, using the specified material.
         // The size of the sprite is taken from the size of the texture.
-        Iw2DDrawImage(logoImage, CIwSVec2(x, y));
+        RenderDrawImage(IMAGE_LOGO, x, y);
 
         // Draw a play button to start Skillz
         playX = x;
         playY = y + (displayHeight / 2);
-        Iw2DDrawImage(playImage, CIwSVec2(playX, playY));
+        RenderDrawImage(IMAGE_PLAY, playX, playY);
     }
 };
 
@@ -0,0 +1,176 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#include "trace.h"
+
+#ifdef IW_DEBUG
+
+#include "profile.h"
+#include "s3eConfig.h"
+#include "s3eDebug.h"
+#include "s3eFile.h"
+#include "s3eTimer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+enum TraceEventType
+{
+    TRACE_TYPE_BEGIN,
+    TRACE_TYPE_END,
+    TRACE_TYPE_INSTANT,
+    TRACE_TYPE_COUNTER,
+};
+
+struct TraceEvent
+{
+    uint8 type;
+    uint8 id;           // Phase for begin/end, TraceEventId otherwise
+    int32 args[2];
+    uint64 timeUs;
+};
+
+static const char* s_EventNames[NUM_TRACE_EVENTS] =
+{
+    "LandPiece",
+    "Explode",
+    "NewPiece",
+    "Level",
+    "Particles",
+    "Allocations",
+    "EffectQuality",
+};
+
+static s3eFile* s_TraceFile = NULL;
+static uint64 s_StartTime = 0;
+
+// Events are added at s_Head and written out from s_Tail
+static TraceEvent s_Buffer[TRACE_BUFFER_SIZE];
+static int s_Head = 0;
+static int s_Tail = 0;
+static int s_Dropped = 0;
+static bool s_FirstEvent = true;
+
+static void Add(int type, int id, int arg0, int arg1)
+{
+    if (!s_TraceFile)
+        return;
+
+    int next = (s_Head + 1) % TRACE_BUFFER_SIZE;
+    if (next == s_Tail)
+    {
+        s_Dropped++;
+        return;
+    }
+
+    TraceEvent& e = s_Buffer[s_Head];
+    e.type = (uint8)type;
+    e.id = (uint8)id;
+    e.args[0] = arg0;
+    e.args[1] = arg1;
+    e.timeUs = s3eTimerGetUSTNanoseconds() / 1000 - s_StartTime;
+    s_Head = next;
+}
+
+void TraceInit()
+{
+    char filename[S3E_CONFIG_STRING_MAX] = {0};
+    if (s3eConfigGetString("Blocslot", "TraceFile", filename) != S3E_RESULT_SUCCESS || !filename[0])
+        return;
+
+    s_TraceFile = s3eFileOpen(filename, "wb");
+    if (!s_TraceFile)
+        return;
+
+    s_StartTime = s3eTimerGetUSTNanoseconds() / 1000;
+    s3eFilePrintf(s_TraceFile, "[\n");
+}
+
+void TraceTerminate()
+{
+    if (!s_TraceFile)
+        return;
+
+    TraceFlush();
+    s3eFilePrintf(s_TraceFile, "\n]\n");
+    s3eFileClose(s_TraceFile);
+    s_TraceFile = NULL;
+}
+
+void TraceFlush()
+{
+    if (!s_TraceFile)
+        return;
+
+    char line[160];
+    for (; s_Tail != s_Head; s_Tail = (s_Tail + 1) % TRACE_BUFFER_SIZE)
+    {
+        TraceEvent const & e = s_Buffer[s_Tail];
+        const char* separator = s_FirstEvent ? "" : ",\n";
+        s_FirstEvent = false;
+
+        unsigned long long ts = e.timeUs;
+        switch (e.type)
+        {
+        case TRACE_TYPE_BEGIN:
+        case TRACE_TYPE_END:
+            snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":1}",
+                separator, ProfileGetPhaseName(e.id), e.type == TRACE_TYPE_BEGIN ? 'B' : 'E', ts);
+            break;
+        case TRACE_TYPE_INSTANT:
+            if (e.id == TRACE_EXPLODE)
+                snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":1,\"tid\":1,\"args\":{\"tiles\":%d,\"multiplier\":%d}}",
+                    separator, s_EventNames[e.id], ts, e.args[0], e.args[1]);
+            else if (e.id == TRACE_LEVEL)
+                snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":1,\"tid\":1,\"args\":{\"level\":%d}}",
+                    separator, s_EventNames[e.id], ts, e.args[0]);
+            else
+                snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":1,\"tid\":1}",
+                    separator, s_EventNames[e.id], ts);
+            break;
+        case TRACE_TYPE_COUNTER:
+            snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%llu,\"pid\":1,\"args\":{\"value\":%d}}",
+                separator, s_EventNames[e.id], ts, e.args[0]);
+            break;
+        }
+        s3eFileWrite(line, 1, strlen(line), s_TraceFile);
+    }
+
+    if (s_Dropped)
+    {
+        s3eDebugTracePrintf("Trace: buffer full, %d events dropped", s_Dropped);
+        s_Dropped = 0;
+    }
+}
+
+void TraceBeginPhase(int phase)
+{
+    Add(TRACE_TYPE_BEGIN, phase, 0, 0);
+}
+
+void TraceEndPhase(int phase)
+{
+    Add(TRACE_TYPE_END, phase, 0, 0);
+}
+
+void TraceInstant(int event, int arg0, int arg1)
+{
+    Add(TRACE_TYPE_INSTANT, event, arg0, arg1);
+}
+
+void TraceCounter(int event, int value)
+{
+    Add(TRACE_TYPE_COUNTER, event, value, 0);
+}
+
+#endif // IW_DEBUG
@@ -0,0 +1,65 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "s3eTypes.h"
+
+// Trace export in Chrome trace-event format (load the file in chrome://tracing or Perfetto).
+// Enabled by setting TraceFile in the [Blocslot] section of app.icf. The PROFILE_SCOPE phases (see profile.h) are written
+// as begin/end spans, along with the gameplay events and counters below.
+// Events are stored in a ring buffer, which TraceFlush writes out while the main loop is waiting for the next frame.
+// If the buffer fills up between flushes, further events are dropped (and the number dropped is reported).
+// Like the profiler, this is only compiled into debug builds.
+
+enum TraceEventId
+{
+    TRACE_LAND_PIECE,   // The active piece has landed
+    TRACE_EXPLODE,      // A group exploded. Arguments: number of tiles, multiplier
+    TRACE_NEW_PIECE,
+    TRACE_LEVEL,        // The level has changed. Argument: new level
+    TRACE_PARTICLES,    // Counter: number of explosion fragments and other effects
+    TRACE_ALLOCATIONS,  // Counter: heap allocations made in the previous frame
+    TRACE_EFFECT_QUALITY,   // Counter: EffectQuality, when it changes
+    NUM_TRACE_EVENTS,
+};
+
+#define TRACE_BUFFER_SIZE 8192
+
+#ifdef IW_DEBUG
+
+void TraceInit();
+void TraceTerminate();
+
+// Write out the events recorded since the last flush
+void TraceFlush();
+
+void TraceBeginPhase(int phase);
+void TraceEndPhase(int phase);
+void TraceInstant(int event, int arg0 = 0, int arg1 = 0);
+void TraceCounter(int event, int value);
+
+#else
+
+inline void TraceInit() {}
+inline void TraceTerminate() {}
+inline void TraceFlush() {}
+inline void TraceBeginPhase(int phase) {}
+inline void TraceEndPhase(int phase) {}
+inline void TraceInstant(int event, int arg0 = 0, int arg1 = 0) {}
+inline void TraceCounter(int event, int value) {}
+
+#endif
+
+#endif /* !_TRACE_H */
@@ -0,0 +1,258 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+// Board scaling benchmark. Plays random pieces on boards of each of a set of sizes with the batch environment, and
+// reports the time taken per piece as CSV. A piece's time covers landing it, finding the groups, the explosions and
+// everything falling, so if each of those is linear in the number of tiles, the time per piece per tile (ns_per_tile)
+// stays about the same as the boards get bigger.
+// The board algorithms in boardrules.h, which the game's Grid uses too, are also timed one at a time on the boards the
+// games reach: connecting the tiles, finding the groups, and one pass of making them fall with the bottom row cleared
+// (so that everything above it falls). These are reported per tile too.
+// Boards larger than 16x24 need BLOCSLOT_MEGA_BOARD, which allows up to 128x256. The games are played on one thread.
+//
+// This is a host tool and doesn't use the Marmalade SDK. Build it with, for example:
+//   c++ -O2 -std=c++11 -DBLOCSLOT_MEGA_BOARD -Isource tools/gridbench.cpp source/batchenv.cpp source/gameparams.cpp -o gridbench -lpthread
+//
+// Usage:
+//   gridbench [-games <n>] [-pieces <n>] [-seed <n>] [-params <file>] [<width>x<height>...]
+// The parameter file, if given, is used for every size (apart from its width and height).
+
+#include "batchenv.h"
+#include "boardrules.h"
+#include "gameparams.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct BoardSize
+{
+    int width, height;
+};
+
+static const BoardSize s_DefaultSizes[] =
+{
+    { 10, 16 },
+    { 16, 24 },
+    { 32, 64 },
+    { 64, 128 },
+    { 128, 256 },
+};
+
+// A copy of a game's board, as the algorithms in boardrules.h see it
+struct BenchBoard
+{
+    int width, height;
+    std::vector<uint8_t> colours;
+    std::vector<uint32_t> connections;
+    std::vector<int> ids;
+    std::vector<int> sizes, starts, tiles, fallScratch;
+
+    BenchBoard(int w, int h) : width(w), height(h), colours(w*h), connections(w*h), ids(w*h), sizes(w*h), starts(w*h),
+        tiles(w*h), fallScratch(BoardFallScratchSize(w*h, w*h)) {}
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int Colour(int i) const { return colours[i]; }
+    uint32_t Connections(int i) const { return connections[i]; }
+    void SetConnections(int i, uint32_t connect) { connections[i] = connect; }
+    int GroupId(int i) const { return ids[i]; }
+    void SetGroupId(int i, int id) { ids[i] = id; }
+
+    void MoveDown(int i)
+    {
+        colours[i+width] = colours[i];
+        connections[i+width] = connections[i];
+        ids[i+width] = ids[i];
+        colours[i] = 0;
+        connections[i] = 0;
+        ids[i] = -1;
+    }
+};
+
+// Seconds taken by each of the board algorithms
+struct AlgorithmTimes
+{
+    double connect, groups, fall;
+};
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Time the board algorithms on a copy of 'cells'
+static void TimeAlgorithms(BenchBoard& board, const uint8_t* cells, AlgorithmTimes& times)
+{
+    int numCells = board.width * board.height;
+    memcpy(&board.colours[0], cells, numCells);
+    memset(&board.connections[0], 0, numCells*sizeof(uint32_t));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    BoardUpdateConnections(board);
+    times.connect += SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    int numGroups = BoardCreateGroups(board, &board.sizes[0], &board.starts[0], &board.tiles[0]);
+    times.groups += SecondsSince(start);
+
+    // As though the bottom row had exploded
+    for (int i=numCells - board.width; i<numCells; i++)
+    {
+        board.colours[i] = 0;
+        board.ids[i] = -1;
+    }
+    start = std::chrono::steady_clock::now();
+    BoardMakeFall(board, numGroups, &board.fallScratch[0]);
+    times.fall += SecondsSince(start);
+}
+
+static bool ReadFile(const char* filename, std::string& text)
+{
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+        return false;
+
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        text.append(buffer, n);
+    fclose(f);
+    return true;
+}
+
+// Play 'numPieces' pieces in each of 'numGames' games of one size, starting new games as they end, and print the results
+static bool Benchmark(BoardSize const & size, std::string const & params, int numGames, int numPieces, uint32_t seed)
+{
+    BlocslotEnv* env = BlocslotEnvCreate(numGames, 1);
+    if (!env)
+    {
+        fprintf(stderr, "couldn't create an environment\n");
+        return false;
+    }
+
+    // Settings later in the text replace earlier ones
+    char sizeText[64];
+    snprintf(sizeText, sizeof(sizeText), "\nwidth %d\nheight %d\n", size.width, size.height);
+    std::string text = params + sizeText;
+    char error[128];
+    if (!BlocslotEnvSetParams(env, text.c_str(), error, sizeof(error)))
+    {
+        fprintf(stderr, "%dx%d: %s\n", size.width, size.height, error);
+        BlocslotEnvDestroy(env);
+        return true;
+    }
+
+    std::vector<uint32_t> seeds(numGames);
+    for (int i=0; i<numGames; i++)
+        seeds[i] = seed + i;
+    BlocslotEnvReset(env, &seeds[0]);
+
+    BlocslotObservations obs;
+    BlocslotEnvGetObservations(env, &obs);
+
+    // The pieces are placed the same way on every run
+    GameRandom random;
+    random.Seed(seed);
+
+    std::vector<int32_t> actions(numGames*2);
+    std::vector<int32_t> rewards(numGames);
+    double totalReward = 0;
+    int gamesEnded = 0;
+    double seconds = 0;
+    BenchBoard board(size.width, size.height);
+    AlgorithmTimes times = { 0, 0, 0 };
+    for (int p=0; p<numPieces; p++)
+    {
+        for (int i=0; i<numGames; i++)
+        {
+            actions[i*2] = random.Range(0, size.width);
+            actions[i*2+1] = random.Range(0, pieceShapes[obs.activeType[i]].numRotations);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        BlocslotEnvStep(env, &actions[0], &rewards[0]);
+        seconds += SecondsSince(start);
+
+        for (int i=0; i<numGames; i++)
+        {
+            TimeAlgorithms(board, obs.boards + i*size.width*size.height, times);
+            totalReward += rewards[i];
+            if (obs.done[i])
+            {
+                BlocslotEnvResetOne(env, i, seed + numGames + gamesEnded);
+                gamesEnded++;
+            }
+        }
+    }
+    BlocslotEnvDestroy(env);
+
+    double pieces = (double)numGames * numPieces;
+    int tiles = size.width * size.height;
+    double nsPerTile = 1e9 / (pieces * tiles);
+    printf("%dx%d,%d,%.0f,%d,%.2f,%.2f,%.1f,%.2f,%.2f,%.2f\n", size.width, size.height, tiles, pieces, gamesEnded,
+        seconds * 1e6 / pieces, seconds * nsPerTile, totalReward / pieces,
+        times.connect * nsPerTile, times.groups * nsPerTile, times.fall * nsPerTile);
+    fflush(stdout);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int numGames = 64;
+    int numPieces = 500;
+    uint32_t seed = 1;
+    std::string params;
+    std::vector<BoardSize> sizes;
+
+    for (int i=1; i<argc; i++)
+    {
+        if (argv[i][0] == '-' && i+1 < argc)
+        {
+            const char* option = argv[i++];
+            if (!strcmp(option, "-games"))
+                numGames = atoi(argv[i]);
+            else if (!strcmp(option, "-pieces"))
+                numPieces = atoi(argv[i]);
+            else if (!strcmp(option, "-seed"))
+                seed = (uint32_t)strtoul(argv[i], NULL, 10);
+            else if (!strcmp(option, "-params") && !ReadFile(argv[i], params))
+            {
+                fprintf(stderr, "couldn't open %s\n", argv[i]);
+                return 1;
+            }
+            continue;
+        }
+
+        BoardSize size;
+        if (sscanf(argv[i], "%dx%d", &size.width, &size.height) != 2)
+        {
+            fprintf(stderr, "usage: %s [-games <n>] [-pieces <n>] [-seed <n>] [-params <file>] [<width>x<height>...]\n", argv[0]);
+            return 1;
+        }
+        sizes.push_back(size);
+    }
+
+    if (sizes.empty())
+        sizes.assign(s_DefaultSizes, s_DefaultSizes + sizeof(s_DefaultSizes)/sizeof(s_DefaultSizes[0]));
+    if (numGames < 1 || numPieces < 1)
+        return 1;
+
+    printf("size,tiles,pieces,games_ended,us_per_piece,ns_per_tile,reward_per_piece,connect_ns_per_tile,groups_ns_per_tile,fall_ns_per_tile\n");
+    for (size_t s=0; s<sizes.size(); s++)
+        if (!Benchmark(sizes[s], params, numGames, numPieces, seed))
+            return 1;
+    return 0;
+}
@@ -0,0 +1,193 @@
+#!/usr/bin/env python
+#
+# This file is part of the Marmalade SDK Code Samples.
+#
+# (C) 2001-2012 Marmalade. All Rights Reserved.
+#
+# This source code is intended only as a supplement to the Marmalade SDK.
+#
+# THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+# KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+# PARTICULAR PURPOSE.
+#
+# Packs the tile sheets for each tile size, together with the star and the touchscreen
+# buttons, into one texture atlas per tile size (data/textures/atlas/atlas<size>.tga),
+# and writes the table of atlas regions used by the rendering code (source/atlasregions.h).
+#
+# Run this from the root of the project whenever any of the packed textures change,
+# before running the [artbuild] deployment to rebuild the resource binaries:
+#   python tools/makeatlas.py
+#
+# Only the standard library is used. Magenta pixels become transparent in the atlas.
+
+import os
+import struct
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+TEXTURES = os.path.join(ROOT, "data", "textures")
+ATLAS_DIR = os.path.join(TEXTURES, "atlas")
+HEADER = os.path.join(ROOT, "source", "atlasregions.h")
+
+TILE_SIZES = [12, 16, 24, 32, 48]
+COLOUR_NAMES = ["", "green", "red", "lt_blue", "purple", "yellow"]
+BUTTON_NAMES = ["touchscreenRotL", "touchscreenRotR", "touchscreenMoveL", "touchscreenMoveDown", "touchscreenMoveR"]
+
+# Gap between packed images, so that filtering doesn't bleed between them
+PADDING = 2
+
+
+def load_bmp(path):
+    """Load an uncompressed 4, 8, 24 or 32 bit BMP as rows of (r, g, b, a), top row first"""
+    data = open(path, "rb").read()
+    if data[:2] != b"BM":
+        raise ValueError("%s is not a BMP file" % path)
+    offset, header_size, width, height, _, bpp, compression = struct.unpack("<IIiiHHI", data[10:34])
+    if compression != 0 or bpp not in (4, 8, 24, 32):
+        raise ValueError("%s: unsupported BMP format" % path)
+    num_colours = struct.unpack("<I", data[46:50])[0] or (1 << bpp if bpp <= 8 else 0)
+    palette_start = 14 + header_size
+    palette = [tuple(bytearray(data[palette_start + 4 * i:palette_start + 4 * i + 3]))[::-1] for i in range(num_colours)]
+
+    bottom_up = height > 0
+    height = abs(height)
+    stride = ((width * bpp + 31) // 32) * 4
+    pixels = bytearray(data)
+
+    rows = []
+    for y in range(height):
+        start = offset + (height - 1 - y if bottom_up else y) * stride
+        row = []
+        for x in range(width):
+            if bpp == 8:
+                r, g, b = palette[pixels[start + x]]
+            elif bpp == 4:
+                byte = pixels[start + x // 2]
+                r, g, b = palette[(byte & 15) if x & 1 else (byte >> 4)]
+            else:
+                p = start + x * (bpp // 8)
+                b, g, r = pixels[p], pixels[p + 1], pixels[p + 2]
+            a = 0 if (r, g, b) == (255, 0, 255) else 255
+            row.append((r, g, b, a))
+        rows.append(row)
+    return rows
+
+
+def crop(rows, w, h):
+    return [row[:w] for row in rows[:h]]
+
+
+def pack(items):
+    """Shelf-pack (name, rows) items into the smallest power of two texture.
+    Returns (width, height, {name: (x, y, w, h)})"""
+    order = sorted(items, key=lambda item: (-len(item[1]), item[0]))
+    best = None
+    for width in (64, 128, 256, 512, 1024, 2048):
+        x = y = shelf = 0
+        placed = {}
+        fits = True
+        for name, rows in order:
+            w, h = len(rows[0]), len(rows)
+            if w > width:
+                fits = False
+                break
+            if x + w > width:
+                x = 0
+                y += shelf + PADDING
+                shelf = 0
+            placed[name] = (x, y, w, h)
+            x += w + PADDING
+            shelf = max(shelf, h)
+        if not fits:
+            continue
+        height = 1
+        while height < y + shelf:
+            height *= 2
+        # Prefer the smallest area, then the squarest shape
+        if best is None or (width * height, max(width, height)) < (best[0] * best[1], max(best[0], best[1])):
+            best = (width, height, placed)
+    return best
+
+
+def write_tga(path, width, height, pixels):
+    """Write an uncompressed 32 bit TGA (bottom-left origin, 8 bits of alpha)"""
+    header = struct.pack("<BBBHHBHHHHBB", 0, 0, 2, 0, 0, 0, 0, 0, width, height, 32, 8)
+    out = bytearray(header)
+    for y in range(height - 1, -1, -1):
+        for r, g, b, a in pixels[y]:
+            out += bytearray((b, g, r, a))
+    open(path, "wb").write(out)
+
+
+def main():
+    if not os.path.isdir(ATLAS_DIR):
+        os.makedirs(ATLAS_DIR)
+
+    # Images packed into every atlas, in RenderImageId order starting at IMAGE_STAR
+    shared = [("star", load_bmp(os.path.join(TEXTURES, "star.bmp")))]
+    buttons = [(name, load_bmp(os.path.join(TEXTURES, name + ".bmp"))) for name in BUTTON_NAMES]
+
+    regions = []
+    for size in TILE_SIZES:
+        # Each sheet is 4x4 tiles; anything beyond that is unused padding in the source bitmap
+        sheets = []
+        for colour in COLOUR_NAMES:
+            name = "tiles%d#%s" % (size, colour)
+            rows = load_bmp(os.path.join(TEXTURES, "tiles%d" % size, name + ".bmp"))
+            sheets.append((name, crop(rows, size * 4, size * 4)))
+
+        items = shared + sheets + buttons
+        width, height, placed = pack(items)
+
+        pixels = [[(255, 0, 255, 0)] * width for _ in range(height)]
+        for name, rows in items:
+            x0, y0, w, h = placed[name]
+            for y in range(h):
+                pixels[y0 + y][x0:x0 + w] = rows[y]
+
+        path = os.path.join(ATLAS_DIR, "atlas%d.tga" % size)
+        write_tga(path, width, height, pixels)
+        print("%s: %dx%d" % (os.path.relpath(path, ROOT), width, height))
+
+        regions.append([placed[name] for name, _ in items])
+
+    with open(HEADER, "w") as f:
+        f.write("""/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+// Generated by tools/makeatlas.py - do not edit.
+// Position of each packed image (IMAGE_STAR onwards, in RenderImageId order) in the atlas for each tile size.
+
+#ifndef _ATLASREGIONS_H
+#define _ATLASREGIONS_H
+
+#define NUM_ATLAS_SIZES %d
+#define NUM_ATLAS_REGIONS %d
+
+static const int g_AtlasTileSizes[NUM_ATLAS_SIZES] = { %s };
+
+static const RenderAtlasRegion g_AtlasRegions[NUM_ATLAS_SIZES][NUM_ATLAS_REGIONS] =
+{
+""" % (len(TILE_SIZES), len(regions[0]), ", ".join(str(s) for s in TILE_SIZES)))
+        for size, size_regions in zip(TILE_SIZES, regions):
+            f.write("    // atlas%d\n    {\n" % size)
+            for x, y, w, h in size_regions:
+                f.write("        { %d, %d, %d, %d },\n" % (x, y, w, h))
+            f.write("    },\n")
+        f.write("};\n\n#endif /* !_ATLASREGIONS_H */\n")
+    print(os.path.relpath(HEADER, ROOT))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
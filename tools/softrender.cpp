@@ -0,0 +1,144 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+// Headless renderer for frames captured by the game (see the RenderCapture setting in app.config.txt).
+// Rasterizes each frame with the software backend, reports draw counts and frame cost, and optionally
+// writes the frames as .tga files or compares them against a previous set of frames.
+//
+// This is a host tool and doesn't use the Marmalade SDK. Build it with, for example:
+//   c++ -O2 -Isource tools/softrender.cpp source/softrender.cpp source/rendercommands.cpp -o softrender
+//
+// Usage:
+//   softrender <capture file> <data directory> [-out <directory>] [-compare <directory>] [-tolerance <n>]
+
+#include "rendercommands.h"
+#include "softrender.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s <capture file> <data directory> [-out <directory>] [-compare <directory>] [-tolerance <n>]\n", argv[0]);
+        return 1;
+    }
+
+    const char* outDir = NULL;
+    const char* compareDir = NULL;
+    int tolerance = 0;
+    for (int i=3; i+1<argc; i+=2)
+    {
+        if (!strcmp(argv[i], "-out"))
+            outDir = argv[i+1];
+        else if (!strcmp(argv[i], "-compare"))
+            compareDir = argv[i+1];
+        else if (!strcmp(argv[i], "-tolerance"))
+            tolerance = atoi(argv[i+1]);
+    }
+
+    FILE* f = fopen(argv[1], "rb");
+    if (!f)
+    {
+        fprintf(stderr, "couldn't open %s\n", argv[1]);
+        return 1;
+    }
+
+    uint32_t header[2];
+    if (fread(header, sizeof(header), 1, f) != 1 || header[0] != RENDER_CAPTURE_MAGIC || header[1] != RENDER_CAPTURE_VERSION)
+    {
+        fprintf(stderr, "%s is not a render capture (or is from a different version)\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+
+    static RenderCommandBuffer buffer;
+    SoftRenderer renderer(argv[2]);
+
+    RenderStats total;
+    memset(&total, 0, sizeof(total));
+    double totalRasterMs = 0;
+    double totalAllocs = 0;
+    int numFrames = 0;
+    int failedFrames = 0;
+
+    printf("frame,commands,images,tiles,rects,strings,image_changes,state_changes,pixels,allocs,alloc_bytes,captured_ms,raster_ms%s\n", compareDir ? ",differences" : "");
+
+    RenderCaptureFrame frame;
+    while (fread(&frame, sizeof(frame), 1, f) == 1)
+    {
+        if (frame.numCommands > MAX_RENDER_COMMANDS || frame.numQuads > MAX_RENDER_TILE_QUADS || frame.stringsUsed > RENDER_STRING_POOL_SIZE
+            || fread(buffer.commands, sizeof(RenderCommand), frame.numCommands, f) != frame.numCommands
+            || fread(buffer.quads, sizeof(RenderTileQuad), frame.numQuads, f) != frame.numQuads
+            || fread(buffer.strings, 1, frame.stringsUsed, f) != frame.stringsUsed)
+        {
+            fprintf(stderr, "capture is truncated or corrupt at frame %d\n", numFrames);
+            break;
+        }
+        buffer.numCommands = frame.numCommands;
+        buffer.numQuads = frame.numQuads;
+        buffer.stringsUsed = frame.stringsUsed;
+
+        clock_t start = clock();
+        renderer.Render(buffer, frame.surfaceWidth, frame.surfaceHeight, frame.tileSize);
+        double rasterMs = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+        RenderStats stats;
+        buffer.GetStats(stats);
+
+        printf("%d,%d,%d,%d,%d,%d,%d,%d,%d,%u,%u,%u,%.3f", numFrames, stats.numCommands, stats.numImages, stats.numTiles, stats.numRects, stats.numStrings,
+            stats.numImageChanges, stats.numStateChanges, stats.pixelsFilled, frame.numAllocs, frame.allocBytes, frame.frameTimeMs, rasterMs);
+
+        char filename[512];
+        if (outDir)
+        {
+            snprintf(filename, sizeof(filename), "%s/frame%05d.tga", outDir, numFrames);
+            if (!renderer.WriteTGA(filename))
+                fprintf(stderr, "couldn't write %s\n", filename);
+        }
+        if (compareDir)
+        {
+            snprintf(filename, sizeof(filename), "%s/frame%05d.tga", compareDir, numFrames);
+            int differences = renderer.CompareTGA(filename, tolerance);
+            printf(",%d", differences);
+            if (differences != 0)
+                failedFrames++;
+        }
+        printf("\n");
+
+        total.numCommands += stats.numCommands;
+        total.numImages += stats.numImages;
+        total.numImageChanges += stats.numImageChanges;
+        total.numStateChanges += stats.numStateChanges;
+        total.pixelsFilled += stats.pixelsFilled;
+        totalRasterMs += rasterMs;
+        totalAllocs += frame.numAllocs;
+        numFrames++;
+    }
+    fclose(f);
+
+    if (numFrames)
+    {
+        fprintf(stderr, "%d frames: %.1f commands, %.1f images, %.1f image changes, %.1f state changes, %.0f pixels, %.1f allocations, %.3fms per frame\n",
+            numFrames, (double)total.numCommands / numFrames, (double)total.numImages / numFrames,
+            (double)total.numImageChanges / numFrames, (double)total.numStateChanges / numFrames,
+            (double)total.pixelsFilled / numFrames, totalAllocs / numFrames, totalRasterMs / numFrames);
+    }
+    if (compareDir)
+        fprintf(stderr, "%d of %d frames differ from %s\n", failedFrames, numFrames, compareDir);
+
+    return failedFrames ? 2 : 0;
+}
@@ -0,0 +1,331 @@
+/*
+ * This file is part of the Marmalade SDK Code Samples.
+ *
+ * (C) 2001-2012 Marmalade. All Rights Reserved.
+ *
+ * This source code is intended only as a supplement to the Marmalade SDK.
+ *
+ * THIS CODE AND INFORMATION ARE PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+ * KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ */
+
+// Difficulty tuning harness. Plays thousands of games with each of a set of parameter files (see gameparams.h), using
+// bots and the batch environment, and reports the distribution of scores, the length of the games and the levels
+// reached for each, as CSV. Every parameter file is played with the same seeds, so the differences between them
+// aren't down to the pieces dealt. The games are divided between threads on every core.
+//
+// This is a host tool and doesn't use the Marmalade SDK. Build it with, for example:
+//   c++ -O2 -std=c++11 -Isource tools/sweep.cpp source/batchenv.cpp source/boardfeatures.cpp source/gameparams.cpp -o sweep -lpthread
+//
+// Usage:
+//   sweep [-games <n>] [-seed <n>] [-bot greedy|random] [-maxpieces <n>] [-threads <n>] <params file|default>...
+
+#include "batchenv.h"
+#include "boardfeatures.h"
+#include "gameparams.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+// Games played together in one environment
+#define SWEEP_BATCH_SIZE 64
+
+enum BotType
+{
+    BOT_GREEDY,     // Tries every placement and picks the best looking board
+    BOT_RANDOM,
+};
+
+struct GameResult
+{
+    int score;
+    int pieces;
+    int level;
+    bool capped;    // Stopped at maxPieces rather than finishing
+};
+
+struct Candidate
+{
+    const char* name;
+    std::string text;
+    GameParams params;      // Parsed from 'text', for the bot's rating of boards
+    std::vector<GameResult> results;
+};
+
+struct Sweep
+{
+    std::vector<Candidate> candidates;
+    int numGames;
+    uint32_t firstSeed;
+    BotType bot;
+    int maxPieces;
+    std::atomic<int> nextBatch;
+    std::mutex errorMutex;
+    bool failed;
+};
+
+static bool ReadFile(const char* filename, std::string& text)
+{
+    FILE* f = fopen(filename, "rb");
+    if (!f)
+        return false;
+
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        text.append(buffer, n);
+    fclose(f);
+    return true;
+}
+
+// How good a board looks to the greedy bot, after gaining 'reward'
+static int RateBoard(const uint8_t* board, int width, int height, int explodeThreshold, int reward)
+{
+    int32_t features[NUM_BOARD_FEATURES];
+    BlocslotComputeFeatures(board, width, height, explodeThreshold, 1, features);
+
+    int maxHeight = 0;
+    int totalHeight = 0;
+    for (int x=0; x<width; x++)
+    {
+        maxHeight = std::max(maxHeight, (int)features[FEATURE_HEIGHT + x]);
+        totalHeight += features[FEATURE_HEIGHT + x];
+    }
+
+    int largest = 0;
+    for (int c=0; c<MAX_NUM_COLOURS; c++)
+        largest += features[FEATURE_LARGEST_GROUP + c];
+
+    return reward + 20*features[FEATURE_CONNECTIONS] + 5*largest + 40*features[FEATURE_NEAR_EXPLODE]
+        - 60*features[FEATURE_HOLES] - 30*features[FEATURE_OVERHANGS] - 5*totalHeight - 10*maxHeight*maxHeight;
+}
+
+static void ChooseAction(BlocslotEnv* env, BlocslotObservations const & obs, int i, GameParams const & params, BotType bot, GameRandom& random, int32_t* action)
+{
+    int width, height;
+    BlocslotEnvGetBoardSize(env, &width, &height);
+
+    int numRotations = pieceShapes[obs.activeType[i]].numRotations;
+    if (bot == BOT_RANDOM)
+    {
+        action[0] = random.Range(0, width);
+        action[1] = random.Range(0, numRotations);
+        return;
+    }
+
+    int best = 0;
+    bool found = false;
+    action[0] = action[1] = 0;
+    for (int r=0; r<numRotations; r++)
+    {
+        for (int x=0; x<width; x++)
+        {
+            uint8_t board[MAX_GAME_CELLS];
+            int32_t reward;
+            uint8_t done;
+            if (!BlocslotEnvTryAction(env, i, x, r, board, &reward, &done))
+                continue;
+
+            int rating = done ? -1000000 + reward : RateBoard(board, width, height, params.explodeThreshold, reward);
+            if (!found || rating > best)
+            {
+                best = rating;
+                found = true;
+                action[0] = x;
+                action[1] = r;
+            }
+        }
+    }
+}
+
+// Play batches of games until none are left
+static void WorkerFunc(Sweep* sweep)
+{
+    int batchesPerCandidate = (sweep->numGames + SWEEP_BATCH_SIZE - 1) / SWEEP_BATCH_SIZE;
+    int numBatches = batchesPerCandidate * (int)sweep->candidates.size();
+
+    BlocslotEnv* env = BlocslotEnvCreate(SWEEP_BATCH_SIZE, 1);
+    if (!env)
+    {
+        std::lock_guard<std::mutex> lock(sweep->errorMutex);
+        fprintf(stderr, "couldn't create an environment\n");
+        sweep->failed = true;
+        return;
+    }
+
+    BlocslotObservations obs;
+    BlocslotEnvGetObservations(env, &obs);
+
+    int batch;
+    while ((batch = sweep->nextBatch++) < numBatches)
+    {
+        Candidate& candidate = sweep->candidates[batch / batchesPerCandidate];
+        int first = (batch % batchesPerCandidate) * SWEEP_BATCH_SIZE;
+        int count = std::min(SWEEP_BATCH_SIZE, sweep->numGames - first);
+
+        char error[128];
+        if (!BlocslotEnvSetParams(env, candidate.text.c_str(), error, sizeof(error)))
+        {
+            std::lock_guard<std::mutex> lock(sweep->errorMutex);
+            fprintf(stderr, "%s: %s\n", candidate.name, error);
+            sweep->failed = true;
+            break;
+        }
+
+        uint32_t seeds[SWEEP_BATCH_SIZE];
+        for (int i=0; i<SWEEP_BATCH_SIZE; i++)
+            seeds[i] = sweep->firstSeed + first + i;
+        BlocslotEnvReset(env, seeds);
+
+        // The random bot's choices come from the seed too, so every run is the same
+        GameRandom random;
+        random.Seed(sweep->firstSeed + first);
+
+        bool finished[SWEEP_BATCH_SIZE] = {false};
+        int numFinished = 0;
+        int32_t actions[SWEEP_BATCH_SIZE*2] = {0};
+        while (numFinished < count)
+        {
+            for (int i=0; i<count; i++)
+                if (!finished[i])
+                    ChooseAction(env, obs, i, candidate.params, sweep->bot, random, actions + i*2);
+
+            BlocslotEnvStep(env, actions, NULL);
+
+            for (int i=0; i<count; i++)
+            {
+                if (finished[i] || (!obs.done[i] && obs.pieces[i] < sweep->maxPieces))
+                    continue;
+
+                GameResult& result = candidate.results[first + i];
+                result.score = obs.score[i];
+                result.pieces = obs.pieces[i];
+                result.level = obs.level[i];
+                result.capped = !obs.done[i];
+                finished[i] = true;
+                numFinished++;
+            }
+        }
+    }
+
+    BlocslotEnvDestroy(env);
+}
+
+// Value at fraction 'f' of the way through the sorted values
+template <class T> static T Percentile(std::vector<T> const & sorted, double f)
+{
+    return sorted[std::min(sorted.size() - 1, (size_t)(f * sorted.size()))];
+}
+
+int main(int argc, char* argv[])
+{
+    Sweep sweep;
+    sweep.numGames = 1000;
+    sweep.firstSeed = 1;
+    sweep.bot = BOT_GREEDY;
+    sweep.maxPieces = 1000;
+    sweep.nextBatch = 0;
+    sweep.failed = false;
+    int numThreads = (int)std::thread::hardware_concurrency();
+
+    for (int i=1; i<argc; i++)
+    {
+        if (argv[i][0] == '-' && i+1 < argc)
+        {
+            const char* option = argv[i++];
+            if (!strcmp(option, "-games"))
+                sweep.numGames = atoi(argv[i]);
+            else if (!strcmp(option, "-seed"))
+                sweep.firstSeed = (uint32_t)strtoul(argv[i], NULL, 10);
+            else if (!strcmp(option, "-bot"))
+                sweep.bot = strcmp(argv[i], "random") ? BOT_GREEDY : BOT_RANDOM;
+            else if (!strcmp(option, "-maxpieces"))
+                sweep.maxPieces = atoi(argv[i]);
+            else if (!strcmp(option, "-threads"))
+                numThreads = atoi(argv[i]);
+            continue;
+        }
+
+        Candidate candidate;
+        candidate.name = argv[i];
+        if (strcmp(argv[i], "default") && !ReadFile(argv[i], candidate.text))
+        {
+            fprintf(stderr, "couldn't open %s\n", argv[i]);
+            return 1;
+        }
+        char error[128];
+        candidate.params = g_DefaultGameParams;
+        if (!GameParamsParse(candidate.params, candidate.text.c_str(), error, sizeof(error)))
+        {
+            fprintf(stderr, "%s: %s\n", argv[i], error);
+            return 1;
+        }
+        sweep.candidates.push_back(candidate);
+    }
+
+    if (sweep.candidates.empty() || sweep.numGames < 1)
+    {
+        fprintf(stderr, "usage: %s [-games <n>] [-seed <n>] [-bot greedy|random] [-maxpieces <n>] [-threads <n>] <params file|default>...\n", argv[0]);
+        return 1;
+    }
+    for (size_t c=0; c<sweep.candidates.size(); c++)
+        sweep.candidates[c].results.resize(sweep.numGames);
+
+    time_t start = time(NULL);
+    std::vector<std::thread> threads;
+    for (int t=0; t<std::max(numThreads, 1); t++)
+        threads.push_back(std::thread(WorkerFunc, &sweep));
+    for (size_t t=0; t<threads.size(); t++)
+        threads[t].join();
+    if (sweep.failed)
+        return 1;
+
+    printf("params,games,capped,score_mean,score_p10,score_p50,score_p90,score_max,pieces_mean,pieces_p10,pieces_p50,pieces_p90,level_mean");
+    for (int l=1; l<=MAX_LEVEL; l++)
+        printf(",level%d", l);
+    printf("\n");
+
+    for (size_t c=0; c<sweep.candidates.size(); c++)
+    {
+        Candidate const & candidate = sweep.candidates[c];
+        std::vector<int> scores, pieces;
+        int levels[MAX_LEVEL+1] = {0};
+        int capped = 0;
+        double totalScore = 0, totalPieces = 0, totalLevel = 0;
+        for (size_t g=0; g<candidate.results.size(); g++)
+        {
+            GameResult const & result = candidate.results[g];
+            scores.push_back(result.score);
+            pieces.push_back(result.pieces);
+            levels[result.level]++;
+            capped += result.capped;
+            totalScore += result.score;
+            totalPieces += result.pieces;
+            totalLevel += result.level;
+        }
+        std::sort(scores.begin(), scores.end());
+        std::sort(pieces.begin(), pieces.end());
+
+        int n = (int)candidate.results.size();
+        printf("%s,%d,%d,%.1f,%d,%d,%d,%d,%.1f,%d,%d,%d,%.2f", candidate.name, n, capped,
+            totalScore / n, Percentile(scores, 0.1), Percentile(scores, 0.5), Percentile(scores, 0.9), scores.back(),
+            totalPieces / n, Percentile(pieces, 0.1), Percentile(pieces, 0.5), Percentile(pieces, 0.9), totalLevel / n);
+        for (int l=1; l<=MAX_LEVEL; l++)
+            printf(",%d", levels[l]);
+        printf("\n");
+    }
+
+    fprintf(stderr, "%d games with %d parameter sets on %d threads in %ds\n", sweep.numGames * (int)sweep.candidates.size(),
+        (int)sweep.candidates.size(), (int)threads.size(), (int)(time(NULL) - start));
+    return 0;
+}